@@ -8,7 +8,7 @@ from time import sleep
 def consumer_example(repeat=10) -> list:
     # Create a consumer instance
     shm_name = "shared_memory_4k_rgb"
-    consumer = shm.ProducerConsumer(shm_name)
+    consumer = shm.SharedValueProducerConsumer(shm_name)
     
     # Consume the image
     result = []
@@ -41,18 +41,27 @@ def atomic_consumer_example(repeat=10) -> list:
             break
     return result
 
-def consumer_example_nb(repeat=10) -> list:
+def consumer_example_nb(repeat=10, timeout_s=10.0, poll_interval_s=0.0005) -> list:
     # Create a consumer instance
     shm_name = "shared_memory_4k_rgb_nb"
     consumer = shm_nb.ProducerConsumer(shm_name)
     
-    # Consume the image
+    # Consume the image, polling the metadata instead of copying every frame;
+    # gives up after timeout_s if the producer publishes fewer frames
     result = []
-    for _ in range(repeat):
+    last_seen = 0
+    deadline = perf_counter() + int(timeout_s * 1e9)
+    while len(result) < repeat and perf_counter() < deadline:
+        meta = consumer.peek()
+        if meta.sequence == last_seen:
+            sleep(poll_interval_s)
+            continue
         start = int(perf_counter())
-        retrieved_image = consumer.load()
-        # timestamp = retrieved_image.timestamp
+        retrieved_image = consumer.load_if_newer(last_seen)
         end = int(perf_counter())
+        last_seen = meta.sequence
+        if retrieved_image is None:
+            continue
         elapsed_time = (end - start) / 1e6  # in milliseconds
         result.append(elapsed_time)
         if retrieved_image.frame_number == repeat - 1:
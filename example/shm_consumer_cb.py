@@ -17,8 +17,8 @@ print(f"Retrieved data shape: {retrieved_data.shape}")
 def producer_example():
     # Create a producer instance
     shm_name = "shared_memory_4k_rgb"
-    producer = shm.ProducerConsumer.create(shm_name)
-    print("ProducerConsumer created:", pc)  # ensure this is a valid object
+    producer = shm.SharedValueProducerConsumer.create(shm_name)
+    print("SharedValueProducerConsumer created:", pc)  # ensure this is a valid object
 
     
     # Create a dummy 4K RGB image using numpy
@@ -40,7 +40,7 @@ def producer_example():
 def consumer_example():
     # Create a consumer instance
     shm_name = "shared_memory_4k_rgb"
-    consumer = shm.ProducerConsumer(shm_name)
+    consumer = shm.SharedValueProducerConsumer(shm_name)
     
     # Consume the image
     retrieved_image = consumer.load()
@@ -55,7 +55,7 @@ def consumer_example():
 def consumer_with_callback_example():
     # Create a consumer instance
     shm_name = "shared_memory_4k_rgb"
-    consumer = shm.ProducerConsumer(shm_name)
+    consumer = shm.SharedValueProducerConsumer(shm_name)
     
     # Define a callback function
     def process_image(image):
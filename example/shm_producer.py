@@ -33,8 +33,8 @@ print(f"Retrieved timestamp: {image_nb.timestamp}")
 def producer_example(repeat=10) -> list:
     # Create a producer instance
     shm_name = "shared_memory_4k_rgb"
-    producer = shm.ProducerConsumer(shm_name)
-    print("ProducerConsumer created:", producer)  # ensure this is a valid object
+    producer = shm.SharedValueProducerConsumer(shm_name)
+    print("SharedValueProducerConsumer created:", producer)  # ensure this is a valid object
     
     result = []
     for frame_id in range(repeat):
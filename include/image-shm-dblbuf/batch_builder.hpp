@@ -0,0 +1,326 @@
+#pragma once
+#include "image-shm-dblbuf/image.hpp"
+#include <algorithm> // std::min
+#include <array>     // std::array
+#include <bit>       // std::bit_cast
+#include <condition_variable> // std::condition_variable_any
+#include <cstddef>   // std::size_t
+#include <cstdint>   // std::uint16_t, std::uint64_t
+#include <memory>    // std::unique_ptr
+#include <mutex>     // std::mutex, std::unique_lock
+#include <stdexcept> // std::runtime_error
+#include <thread>    // std::jthread
+#include <type_traits> // std::is_same_v
+#include <vector>    // std::vector
+
+namespace img
+{
+    enum class TensorLayout : std::uint8_t
+    {
+        NCHW,
+        NHWC,
+    };
+
+    // IEEE 754 binary16 storage, bit compatible with numpy.float16 / torch.half
+    struct Half
+    {
+        std::uint16_t bits;
+    };
+
+    inline Half to_half(float value) noexcept
+    {
+#if defined(__FLT16_MAX__)
+        return {std::bit_cast<std::uint16_t>(static_cast<_Float16>(value))};
+#else
+        auto const f = std::bit_cast<std::uint32_t>(value);
+        auto const sign = static_cast<std::uint16_t>((f >> 16) & 0x8000u);
+        auto const abs = f & 0x7fffffffu;
+        if (abs >= 0x7f800000u) // inf / nan
+        {
+            return {static_cast<std::uint16_t>(sign | 0x7c00u | (abs > 0x7f800000u ? 0x200u : 0u))};
+        }
+        if (abs >= 0x477ff000u) // overflow after rounding
+        {
+            return {static_cast<std::uint16_t>(sign | 0x7c00u)};
+        }
+        if (abs < 0x38800000u) // subnormal or zero
+        {
+            auto const shifted = std::bit_cast<float>(abs) + 0.5f;
+            return {static_cast<std::uint16_t>(sign | (std::bit_cast<std::uint32_t>(shifted) - 0x3f000000u))};
+        }
+        auto const rounded = abs + 0xfffu + ((abs >> 13) & 1u) - 0x38000000u;
+        return {static_cast<std::uint16_t>(sign | (rounded >> 13))};
+#endif
+    }
+
+    struct BatchConfig
+    {
+        std::size_t batch_size = 1;
+        std::size_t width = 0;  // output width, 0 keeps the source width
+        std::size_t height = 0; // output height, 0 keeps the source height
+        TensorLayout layout = TensorLayout::NCHW;
+        // Per output channel, in [0, 1] units: out = (pixel / 255 - mean) / std
+        std::array<float, 4> mean = {0.0f, 0.0f, 0.0f, 0.0f};
+        std::array<float, 4> std = {1.0f, 1.0f, 1.0f, 1.0f};
+        // Output channel c reads source channel channel_order[c], e.g. {2, 1, 0} for RGB -> BGR
+        std::array<std::uint8_t, 4> channel_order = {0, 1, 2, 3};
+        std::size_t threads = 1;
+    };
+
+    // Converts HWC uint8 frames into a preallocated, reusable float32 / fp16 batch tensor.
+    // Resize (nearest neighbour), normalization and channel swizzle are done in a single pass
+    // over the source, so a frame can be read straight from a shared memory slot. With
+    // config.threads > 1 the rows are split across worker threads started once by the constructor.
+    template <typename IMAGE, typename OUT = float>
+    struct BatchBuilder
+    {
+        static_assert(IMAGE::type != ImageType::NV12, "BatchBuilder requires an interleaved RGB / RGBA image");
+        static constexpr std::size_t channels = static_cast<std::size_t>(img::channels(IMAGE::type));
+
+        explicit BatchBuilder(BatchConfig const &config)
+            : config_(config),
+              width_(config.width ? config.width : IMAGE::width),
+              height_(config.height ? config.height : IMAGE::height),
+              frame_size_(width_ * height_ * channels),
+              buffer_(std::make_unique_for_overwrite<OUT[]>(config.batch_size * frame_size_)),
+              x_offsets_(width_),
+              y_offsets_(height_),
+              timestamps_(config.batch_size),
+              frame_numbers_(config.batch_size),
+              threads_(std::clamp<std::size_t>(config.threads, 1, height_)),
+              rows_per_thread_((height_ + threads_ - 1) / threads_)
+        {
+            if (config_.batch_size == 0)
+            {
+                throw std::runtime_error("BatchBuilder: batch_size must be greater than zero");
+            }
+            for (std::size_t c = 0; c < channels; ++c)
+            {
+                if (config_.channel_order[c] >= channels)
+                {
+                    throw std::runtime_error("BatchBuilder: channel_order refers to a missing source channel");
+                }
+                if (config_.std[c] == 0.0f)
+                {
+                    throw std::runtime_error("BatchBuilder: std must be non-zero for every channel");
+                }
+                scale_[c] = 1.0f / (255.0f * config_.std[c]);
+                bias_[c] = -config_.mean[c] / config_.std[c];
+            }
+            for (std::size_t x = 0; x < width_; ++x)
+            {
+                x_offsets_[x] = (x * IMAGE::width / width_) * channels;
+            }
+            for (std::size_t y = 0; y < height_; ++y)
+            {
+                y_offsets_[y] = (y * IMAGE::height / height_) * IMAGE::width * channels;
+            }
+            workers_.reserve(threads_ - 1);
+            for (std::size_t t = 1; t < threads_; ++t)
+            {
+                workers_.emplace_back([this, t](std::stop_token stop)
+                                      { work(stop, t); });
+            }
+        }
+
+        // Workers hold a pointer to the builder
+        BatchBuilder(BatchBuilder const &) = delete;
+        BatchBuilder &operator=(BatchBuilder const &) = delete;
+
+        // Appends a frame to the next free batch slot and returns the slot index
+        inline std::size_t add(IMAGE const &image)
+        {
+            if (full())
+            {
+                throw std::runtime_error("BatchBuilder: batch is full");
+            }
+            write(count_, image);
+            return count_++;
+        }
+
+        // Overwrites a specific batch slot
+        void write(std::size_t index, IMAGE const &image)
+        {
+            if (index >= config_.batch_size)
+            {
+                throw std::runtime_error("BatchBuilder: batch index out of range");
+            }
+            timestamps_[index] = image.timestamp;
+            frame_numbers_[index] = image.frame_number;
+
+            if (workers_.empty())
+            {
+                convert_rows(index, image, 0, height_);
+                return;
+            }
+            {
+                std::lock_guard lock(job_mutex_);
+                job_index_ = index;
+                job_image_ = &image;
+                job_pending_ = workers_.size();
+                ++job_generation_;
+            }
+            job_ready_.notify_all();
+            convert_share(0);
+            std::unique_lock lock(job_mutex_);
+            job_done_.wait(lock, [this]
+                           { return job_pending_ == 0; });
+        }
+
+        inline void reset() noexcept
+        {
+            count_ = 0;
+        }
+
+        inline std::size_t size() const noexcept
+        {
+            return count_;
+        }
+
+        inline bool full() const noexcept
+        {
+            return count_ == config_.batch_size;
+        }
+
+        inline OUT *data() noexcept
+        {
+            return buffer_.get();
+        }
+
+        inline OUT const *data() const noexcept
+        {
+            return buffer_.get();
+        }
+
+        inline std::array<std::size_t, 4> shape() const noexcept
+        {
+            if (config_.layout == TensorLayout::NCHW)
+            {
+                return {config_.batch_size, channels, height_, width_};
+            }
+            return {config_.batch_size, height_, width_, channels};
+        }
+
+        inline std::vector<std::uint64_t> const &timestamps() const noexcept
+        {
+            return timestamps_;
+        }
+
+        inline std::vector<std::uint64_t> const &frame_numbers() const noexcept
+        {
+            return frame_numbers_;
+        }
+
+        inline BatchConfig const &config() const noexcept
+        {
+            return config_;
+        }
+
+    private:
+        BatchConfig config_;
+        std::size_t width_;
+        std::size_t height_;
+        std::size_t frame_size_;
+        std::unique_ptr<OUT[]> buffer_;
+        std::vector<std::size_t> x_offsets_;
+        std::vector<std::size_t> y_offsets_;
+        std::array<float, channels> scale_{};
+        std::array<float, channels> bias_{};
+        std::vector<std::uint64_t> timestamps_;
+        std::vector<std::uint64_t> frame_numbers_;
+        std::size_t count_ = 0;
+        std::size_t threads_;
+        std::size_t rows_per_thread_;
+
+        // Current write() job, published to the workers under job_mutex_
+        std::mutex job_mutex_;
+        std::condition_variable_any job_ready_;
+        std::condition_variable_any job_done_;
+        std::uint64_t job_generation_ = 0;
+        std::size_t job_pending_ = 0;
+        std::size_t job_index_ = 0;
+        IMAGE const *job_image_ = nullptr;
+        std::vector<std::jthread> workers_; // last, so the workers stop before the state they use goes away
+
+        static inline OUT convert(float value) noexcept
+        {
+            if constexpr (std::is_same_v<OUT, Half>)
+            {
+                return to_half(value);
+            }
+            else
+            {
+                return static_cast<OUT>(value);
+            }
+        }
+
+        // Rows of the current job that belong to thread t
+        void convert_share(std::size_t t) noexcept
+        {
+            auto const begin = std::min(t * rows_per_thread_, height_);
+            auto const end = std::min(begin + rows_per_thread_, height_);
+            convert_rows(job_index_, *job_image_, begin, end);
+        }
+
+        void work(std::stop_token stop, std::size_t t)
+        {
+            std::uint64_t seen = 0;
+            while (true)
+            {
+                {
+                    std::unique_lock lock(job_mutex_);
+                    if (!job_ready_.wait(lock, stop, [this, seen]
+                                         { return job_generation_ != seen; }))
+                    {
+                        return;
+                    }
+                    seen = job_generation_;
+                }
+                convert_share(t);
+                {
+                    std::lock_guard lock(job_mutex_);
+                    --job_pending_;
+                }
+                job_done_.notify_one();
+            }
+        }
+
+        void convert_rows(std::size_t index, IMAGE const &image, std::size_t begin, std::size_t end) const noexcept
+        {
+            auto *const out = buffer_.get() + index * frame_size_;
+            auto const *const src = image.data.data();
+            auto const *const x_offsets = x_offsets_.data();
+
+            for (std::size_t y = begin; y < end; ++y)
+            {
+                auto const *const src_row = src + y_offsets_[y];
+                if (config_.layout == TensorLayout::NCHW)
+                {
+                    for (std::size_t c = 0; c < channels; ++c)
+                    {
+                        auto *const dst = out + (c * height_ + y) * width_;
+                        auto const *const src_channel = src_row + config_.channel_order[c];
+                        auto const scale = scale_[c];
+                        auto const bias = bias_[c];
+                        for (std::size_t x = 0; x < width_; ++x)
+                        {
+                            dst[x] = convert(static_cast<float>(src_channel[x_offsets[x]]) * scale + bias);
+                        }
+                    }
+                }
+                else
+                {
+                    auto *const dst = out + y * width_ * channels;
+                    for (std::size_t x = 0; x < width_; ++x)
+                    {
+                        auto const *const pixel = src_row + x_offsets[x];
+                        for (std::size_t c = 0; c < channels; ++c)
+                        {
+                            dst[x * channels + c] = convert(static_cast<float>(pixel[config_.channel_order[c]]) * scale_[c] + bias_[c]);
+                        }
+                    }
+                }
+            }
+        }
+    };
+} // namespace img
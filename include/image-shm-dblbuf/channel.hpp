@@ -0,0 +1,413 @@
+#pragma once
+#include "flat-type/flat.hpp"
+#include "image-shm-dblbuf/futex.hpp"
+#include "image-shm-dblbuf/realtime.hpp"
+#include "shm/semaphore.hpp"
+#include "shm/shm.hpp"
+#include <algorithm> // std::min
+#include <array>   // std::array
+#include <atomic>  // std::atomic
+#include <cstdint> // std::uint64_t, std::uintptr_t
+#include <cstring> // std::memcpy
+#include <memory>  // std::unique_ptr
+#include <thread>  // std::this_thread::yield
+#include <utility> // std::forward
+#if defined(__SSE2__)
+#include <emmintrin.h> // _mm_stream_si128
+#endif
+
+// Compile-time configurable shared memory channel. SyncPolicy protects a slot against torn reads,
+// CopyPolicy is the copy kernel, NotifyPolicy decides how readers learn about new values and
+// whether writers wait for them. Every hook is a template, so the whole path inlines.
+namespace flat_shm
+{
+    template <typename T>
+    struct alignas(64) ChannelSlot
+    {
+        std::atomic<std::uint64_t> version;  // SeqLock: odd while being written
+        std::atomic<std::uint64_t> sequence; // sequence of the value in data, written under the sync policy
+        alignas(64) T data;
+    };
+
+    struct alignas(64) ChannelHeader
+    {
+        std::atomic<std::uint64_t> published; // sequence of the last completed write, 0 before the first
+        alignas(64) std::atomic<std::uint32_t> notify_word;
+    };
+
+    namespace copy
+    {
+        struct Assign
+        {
+            template <typename T>
+            static inline void copy(T &dst, T const &src) noexcept
+            {
+                dst = src;
+            }
+        };
+
+        struct Memcpy
+        {
+            template <typename T>
+            static inline void copy(T &dst, T const &src) noexcept
+            {
+                std::memcpy(&dst, &src, sizeof(T));
+            }
+        };
+
+        // Non-temporal stores: a frame written for another process does not evict the writer's cache
+        struct Streaming
+        {
+            template <typename T>
+            static inline void copy(T &dst, T const &src) noexcept
+            {
+#if defined(__SSE2__)
+                auto *d = reinterpret_cast<char *>(&dst);
+                auto const *s = reinterpret_cast<char const *>(&src);
+                std::size_t size = sizeof(T);
+                auto const head = std::min(size, (16 - reinterpret_cast<std::uintptr_t>(d) % 16) % 16);
+                std::memcpy(d, s, head);
+                d += head;
+                s += head;
+                size -= head;
+                for (; size >= 64; size -= 64, d += 64, s += 64)
+                {
+                    auto const a = _mm_loadu_si128(reinterpret_cast<__m128i const *>(s));
+                    auto const b = _mm_loadu_si128(reinterpret_cast<__m128i const *>(s + 16));
+                    auto const c = _mm_loadu_si128(reinterpret_cast<__m128i const *>(s + 32));
+                    auto const e = _mm_loadu_si128(reinterpret_cast<__m128i const *>(s + 48));
+                    _mm_stream_si128(reinterpret_cast<__m128i *>(d), a);
+                    _mm_stream_si128(reinterpret_cast<__m128i *>(d + 16), b);
+                    _mm_stream_si128(reinterpret_cast<__m128i *>(d + 32), c);
+                    _mm_stream_si128(reinterpret_cast<__m128i *>(d + 48), e);
+                }
+                std::memcpy(d, s, size);
+                _mm_sfence();
+#else
+                std::memcpy(&dst, &src, sizeof(T));
+#endif
+            }
+        };
+    } // namespace copy
+
+    namespace sync
+    {
+        // No protection: correct with notify::Handshake, or when readers keep up with SLOTS - 1 writes
+        struct None
+        {
+            static constexpr bool needs_staging = false;
+
+            explicit None(std::string const &) {}
+
+            template <typename COPY, typename T>
+            inline void write(ChannelSlot<T> &slot, std::uint64_t sequence, T const &src) noexcept
+            {
+                COPY::copy(slot.data, src);
+                slot.sequence.store(sequence, std::memory_order_relaxed);
+            }
+
+            template <typename COPY, typename T, typename FUNC>
+            inline std::uint64_t visit(ChannelSlot<T> &slot, T *, FUNC &&func)
+            {
+                func(static_cast<T const &>(slot.data));
+                return slot.sequence.load(std::memory_order_relaxed);
+            }
+        };
+
+        // Named semaphore used as a cross-process mutex, as in DoubleBufferShem
+        struct Semaphore
+        {
+            static constexpr bool needs_staging = false;
+
+            explicit Semaphore(std::string const &shm_name)
+                : sem_(shm_name + "_lock", 1)
+            {
+            }
+
+            template <typename COPY, typename T>
+            inline void write(ChannelSlot<T> &slot, std::uint64_t sequence, T const &src) noexcept
+            {
+                sem_.wait();
+                COPY::copy(slot.data, src);
+                slot.sequence.store(sequence, std::memory_order_relaxed);
+                sem_.post();
+            }
+
+            template <typename COPY, typename T, typename FUNC>
+            inline std::uint64_t visit(ChannelSlot<T> &slot, T *, FUNC &&func)
+            {
+                sem_.wait();
+                func(static_cast<T const &>(slot.data));
+                auto const sequence = slot.sequence.load(std::memory_order_relaxed);
+                sem_.post();
+                return sequence;
+            }
+
+        private:
+            shm::Semaphore sem_;
+        };
+
+        // Writers never wait; readers copy out and retry when a write overlapped the copy
+        struct SeqLock
+        {
+            static constexpr bool needs_staging = true;
+
+            explicit SeqLock(std::string const &) {}
+
+            template <typename COPY, typename T>
+            inline void write(ChannelSlot<T> &slot, std::uint64_t sequence, T const &src) noexcept
+            {
+                auto const version = slot.version.load(std::memory_order_relaxed);
+                slot.version.store(version + 1, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_release);
+                COPY::copy(slot.data, src);
+                slot.sequence.store(sequence, std::memory_order_relaxed);
+                slot.version.store(version + 2, std::memory_order_release);
+            }
+
+            template <typename COPY, typename T, typename FUNC>
+            inline std::uint64_t visit(ChannelSlot<T> &slot, T *staging, FUNC &&func)
+            {
+                std::uint64_t sequence = 0;
+                while (true)
+                {
+                    auto const version = slot.version.load(std::memory_order_acquire);
+                    if (version & 1)
+                    {
+                        std::this_thread::yield();
+                        continue;
+                    }
+                    COPY::copy(*staging, slot.data);
+                    sequence = slot.sequence.load(std::memory_order_relaxed);
+                    std::atomic_thread_fence(std::memory_order_acquire);
+                    if (slot.version.load(std::memory_order_relaxed) == version)
+                    {
+                        break;
+                    }
+                }
+                func(static_cast<T const &>(*staging));
+                return sequence;
+            }
+        };
+    } // namespace sync
+
+    namespace notify
+    {
+        // Lossless ping-pong on two named semaphores, the FlatShmProducerConsumer protocol:
+        // the writer waits until the previous value was consumed
+        struct Handshake
+        {
+            explicit Handshake(std::string const &shm_name)
+                : sem_read_(shm_name + "_read", 0),
+                  sem_write_(shm_name + "_write", 1)
+            {
+            }
+
+            inline void before_write() noexcept
+            {
+                sem_write_.wait();
+            }
+
+            inline void after_write(ChannelHeader &) noexcept
+            {
+                sem_read_.post();
+            }
+
+            inline void wait(ChannelHeader &, std::uint64_t) noexcept
+            {
+                sem_read_.wait();
+            }
+
+            inline void after_read() noexcept
+            {
+                sem_write_.post();
+            }
+
+        private:
+            shm::Semaphore sem_read_;
+            shm::Semaphore sem_write_;
+        };
+
+        // Latest-value semantics, readers spin until a sequence newer than the last one read is published.
+        // A reader can see a slot before its sequence is published, so last_seen may be ahead of published.
+        struct Poll
+        {
+            explicit Poll(std::string const &) {}
+
+            inline void before_write() noexcept {}
+            inline void after_write(ChannelHeader &) noexcept {}
+
+            inline void wait(ChannelHeader &header, std::uint64_t last_seen) noexcept
+            {
+                while (header.published.load(std::memory_order_acquire) <= last_seen)
+                {
+                    std::this_thread::yield();
+                }
+            }
+
+            inline void after_read() noexcept {}
+        };
+
+        // Latest-value semantics, readers sleep on a futex in the segment; writers never wait
+        struct Futex
+        {
+            explicit Futex(std::string const &) {}
+
+            inline void before_write() noexcept {}
+
+            inline void after_write(ChannelHeader &header) noexcept
+            {
+                header.notify_word.fetch_add(1, std::memory_order_release);
+                futex::wake_all(header.notify_word);
+            }
+
+            inline void wait(ChannelHeader &header, std::uint64_t last_seen) noexcept
+            {
+                while (true)
+                {
+                    auto const word = header.notify_word.load(std::memory_order_acquire);
+                    if (header.published.load(std::memory_order_acquire) > last_seen)
+                    {
+                        return;
+                    }
+                    futex::wait(header.notify_word, word);
+                }
+            }
+
+            inline void after_read() noexcept {}
+        };
+
+        // Plain shared variable: writers overwrite, readers take whatever the slot holds right now,
+        // even a value they already read
+        struct None
+        {
+            explicit None(std::string const &) {}
+
+            inline void before_write() noexcept {}
+            inline void after_write(ChannelHeader &) noexcept {}
+            inline void wait(ChannelHeader &, std::uint64_t) noexcept {}
+            inline void after_read() noexcept {}
+        };
+    } // namespace notify
+
+    template <FlatType T,
+              std::size_t SLOTS = 1,
+              typename SyncPolicy = sync::None,
+              typename CopyPolicy = copy::Assign,
+              typename NotifyPolicy = notify::Handshake>
+    struct Channel
+    {
+        static_assert(SLOTS > 0, "Channel needs at least one slot");
+
+        struct Layout
+        {
+            ChannelHeader header;
+            std::array<ChannelSlot<T>, SLOTS> slots;
+        };
+
+        Channel(std::string const &shm_name)
+            : impl_(shm_name, sizeof(Layout)),
+              sync_(shm_name),
+              notify_(shm_name)
+        {
+            if constexpr (SyncPolicy::needs_staging)
+            {
+                staging_ = std::make_unique_for_overwrite<T>();
+            }
+        }
+
+        inline void produce(T const &data)
+        {
+            notify_.before_write();
+            auto &header = layout().header;
+            auto const sequence = header.published.load(std::memory_order_relaxed) + 1;
+            sync_.template write<CopyPolicy>(slot(sequence), sequence, data);
+            header.published.store(sequence, std::memory_order_release);
+            notify_.after_write(header);
+        }
+
+        // Waits for a value this reader has not seen and hands it to consumer without type erasure
+        template <typename FUNC>
+        inline void consume(FUNC &&consumer)
+        {
+            auto &header = layout().header;
+            notify_.wait(header, last_seen_);
+            auto const sequence = header.published.load(std::memory_order_acquire);
+            // the slot may already hold a newer value than the one announced, remember what was actually read
+            last_seen_ = sync_.template visit<CopyPolicy>(slot(sequence), staging_.get(), std::forward<FUNC>(consumer));
+            notify_.after_read();
+        }
+
+        // Blocking copy of the next value into out
+        inline void load(T &out)
+        {
+            if constexpr (SyncPolicy::needs_staging)
+            {
+                auto &header = layout().header;
+                notify_.wait(header, last_seen_);
+                auto const sequence = header.published.load(std::memory_order_acquire);
+                last_seen_ = sync_.template visit<CopyPolicy>(slot(sequence), &out, [](T const &) {});
+                notify_.after_read();
+            }
+            else
+            {
+                consume([&out](T const &value)
+                        { CopyPolicy::copy(out, value); });
+            }
+        }
+
+        inline T const &consume_unsafe()
+        {
+            return slot(layout().header.published.load(std::memory_order_acquire)).data;
+        }
+
+        inline std::uint64_t sequence() noexcept
+        {
+            return layout().header.published.load(std::memory_order_acquire);
+        }
+
+        inline std::uint64_t last_seen() const noexcept
+        {
+            return last_seen_;
+        }
+
+        // Locks / pre-faults the segment and the reader's staging copy; pinning and scheduling
+        // belong to the threads calling produce / consume, see rt::apply_to_current_thread
+        rt::RealtimeReport apply_realtime(rt::RealtimeProfile const &profile) noexcept
+        {
+            rt::RealtimeReport report;
+            rt::apply_to_memory(impl_.get(), sizeof(Layout), profile, report);
+            rt::apply_to_memory(staging_.get(), sizeof(T), profile, report);
+            return report;
+        }
+
+    private:
+        shm::Shm impl_;
+        [[no_unique_address]] SyncPolicy sync_;
+        [[no_unique_address]] NotifyPolicy notify_;
+        std::unique_ptr<T> staging_;
+        std::uint64_t last_seen_ = 0;
+
+        inline Layout &layout() noexcept
+        {
+            return *static_cast<Layout *>(impl_.get());
+        }
+
+        inline ChannelSlot<T> &slot(std::uint64_t sequence) noexcept
+        {
+            return layout().slots[sequence % SLOTS];
+        }
+    };
+
+    // Common combinations
+    template <FlatType T>
+    using LatestValueChannel = Channel<T, 3, sync::SeqLock, copy::Memcpy, notify::Futex>;
+
+    template <FlatType T>
+    using LockedChannel = Channel<T, 1, sync::Semaphore, copy::Memcpy, notify::Futex>;
+
+    // The Python ProducerConsumer / AtomicProducerConsumer semantics: store overwrites, load copies
+    // the current value without waiting; nothing protects a load that overlaps a store
+    template <FlatType T, typename CopyPolicy = copy::Assign>
+    using SharedValueChannel = Channel<T, 1, sync::None, CopyPolicy, notify::None>;
+} // namespace flat_shm
@@ -0,0 +1,64 @@
+#pragma once
+#include <cerrno>      // errno
+#include <cstddef>     // offsetof
+#include <cstring>     // std::strerror, std::memcpy
+#include <fmt/core.h>  // fmt::format
+#include <stdexcept>   // std::runtime_error
+#include <string>      // std::string
+#include <string_view> // std::string_view
+#include <sys/socket.h>
+#include <sys/un.h>  // sockaddr_un
+#include <unistd.h>  // close
+#include <utility>   // std::exchange, std::pair, std::swap
+
+// File descriptor and socket helpers shared by the memfd channel and the socket bridge;
+// errors carry the caller's prefix so they read as coming from the calling component
+namespace posix
+{
+    [[noreturn]] inline void throw_errno(std::string_view prefix, std::string_view what)
+    {
+        throw std::runtime_error(fmt::format("{}: {} failed: {}", prefix, what, std::strerror(errno)));
+    }
+
+    struct Fd
+    {
+        Fd() = default;
+        explicit Fd(int fd) noexcept : fd_(fd) {}
+        Fd(Fd &&other) noexcept : fd_(std::exchange(other.fd_, -1)) {}
+        Fd &operator=(Fd &&other) noexcept
+        {
+            std::swap(fd_, other.fd_);
+            return *this;
+        }
+        Fd(Fd const &) = delete;
+        Fd &operator=(Fd const &) = delete;
+        ~Fd()
+        {
+            if (fd_ >= 0)
+            {
+                ::close(fd_);
+            }
+        }
+
+        inline int get() const noexcept
+        {
+            return fd_;
+        }
+
+    private:
+        int fd_ = -1;
+    };
+
+    // Abstract namespace address: leading NUL, no filesystem entry to clean up
+    inline std::pair<sockaddr_un, socklen_t> abstract_address(std::string_view prefix, std::string const &name)
+    {
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        if (name.size() + 1 > sizeof(addr.sun_path))
+        {
+            throw std::runtime_error(fmt::format("{}: socket name '{}' is too long", prefix, name));
+        }
+        std::memcpy(addr.sun_path + 1, name.data(), name.size());
+        return {addr, static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) + 1 + name.size())};
+    }
+} // namespace posix
@@ -0,0 +1,270 @@
+#pragma once
+#include "image-shm-dblbuf/channel.hpp"
+#include "image-shm-dblbuf/futex.hpp"
+#include "image-shm-dblbuf/realtime.hpp"
+#include "shm/shm.hpp"
+#include <array>     // std::array
+#include <atomic>    // std::atomic
+#include <cerrno>    // errno, ESRCH
+#include <chrono>    // std::chrono::steady_clock
+#include <cstdint>   // std::uint32_t, std::uint64_t
+#include <memory>    // std::unique_ptr
+#include <signal.h>  // kill
+#include <stdexcept> // std::runtime_error
+#include <string>    // std::string
+#include <unistd.h>  // getpid
+#include <utility>   // std::forward
+
+namespace flat_shm
+{
+    // Which published frames a subscriber wants; both rules must match
+    struct SubscriptionFilter
+    {
+        std::uint32_t every_nth = 1;     // deliver every Nth published frame
+        std::uint64_t min_period_ns = 0; // deliver one frame per period, paced by a deadline
+
+        static SubscriptionFilter every(std::uint32_t n) noexcept
+        {
+            return {n ? n : 1, 0};
+        }
+
+        static SubscriptionFilter rate(double fps) noexcept
+        {
+            return {1, fps > 0.0 ? static_cast<std::uint64_t>(1e9 / fps) : 0};
+        }
+    };
+
+    namespace detail
+    {
+        struct alignas(64) Subscription
+        {
+            static constexpr std::uint32_t FREE = 0;
+            static constexpr std::uint32_t CLAIMING = UINT32_MAX;
+
+            std::atomic<std::uint32_t> state;   // FREE, CLAIMING or the subscriber pid
+            std::atomic<std::uint32_t> pending; // futex word: a delivered frame awaits the subscriber, coalesces wake-ups
+            SubscriptionFilter filter;
+            std::uint64_t skipped;
+            std::uint64_t next_delivery_ns; // rate filter deadline, 0 until the first delivery
+            std::atomic<std::uint64_t> delivered_sequence;
+
+            inline bool active() const noexcept
+            {
+                auto const owner = state.load(std::memory_order_acquire);
+                return owner != FREE && owner != CLAIMING;
+            }
+        };
+
+        inline std::uint64_t steady_ns() noexcept
+        {
+            return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                                  std::chrono::steady_clock::now().time_since_epoch())
+                                                  .count());
+        }
+    } // namespace detail
+
+    // One producer, up to MAX_SUBSCRIBERS consumers with individual rate filters. The producer
+    // evaluates the filters and only wakes a subscriber when its filter matches,
+    // so low-rate consumers are not woken for frames they would drop. The producer never waits
+    // for a subscriber to catch up: an unconsumed wake-up is coalesced and the subscriber gets
+    // the latest frame. Frames rotate through SLOTS seqlock-protected slots, so a subscriber copies
+    // the frame out without taking a lock and retries only if the producer lapped it meanwhile;
+    // callbacks run on the subscriber's own copy.
+    template <typename T, std::size_t MAX_SUBSCRIBERS = 8, std::size_t SLOTS = 3>
+    struct FlatShmBroadcaster
+    {
+        static_assert(SLOTS > 0, "FlatShmBroadcaster needs at least one slot");
+
+        struct Layout
+        {
+            std::atomic<std::uint64_t> sequence;
+            std::array<detail::Subscription, MAX_SUBSCRIBERS> subscriptions;
+            std::array<ChannelSlot<T>, SLOTS> slots;
+        };
+
+        FlatShmBroadcaster(std::string const &shm_name)
+            : impl_(shm_name, sizeof(Layout)),
+              sync_(shm_name)
+        {
+        }
+
+        // Publishes a frame and wakes the subscribers whose filter matches; now_ns is steady clock time
+        void produce(T const &data, std::uint64_t now_ns = detail::steady_ns())
+        {
+            auto const sequence = layout().sequence.load(std::memory_order_relaxed) + 1;
+            sync_.template write<copy::Memcpy>(layout().slots[sequence % SLOTS], sequence, data);
+            layout().sequence.store(sequence, std::memory_order_release);
+
+            for (std::size_t i = 0; i < MAX_SUBSCRIBERS; ++i)
+            {
+                auto &subscription = layout().subscriptions[i];
+                if (!subscription.active() || !matches(subscription, now_ns))
+                {
+                    continue;
+                }
+                subscription.delivered_sequence.store(sequence, std::memory_order_relaxed);
+                if (subscription.pending.exchange(1, std::memory_order_acq_rel) == 0)
+                {
+                    futex::wake_one(subscription.pending);
+                }
+            }
+        }
+
+        inline std::uint64_t sequence() noexcept
+        {
+            return layout().sequence.load(std::memory_order_relaxed);
+        }
+
+        // Locks / pre-faults the segment; pinning and scheduling belong to the producing thread,
+        // see rt::apply_to_current_thread
+        rt::RealtimeReport apply_realtime(rt::RealtimeProfile const &profile) noexcept
+        {
+            rt::RealtimeReport report;
+            rt::apply_to_memory(impl_.get(), sizeof(Layout), profile, report);
+            return report;
+        }
+
+    private:
+        shm::Shm impl_;
+        [[no_unique_address]] sync::SeqLock sync_;
+
+        inline Layout &layout() noexcept
+        {
+            return *static_cast<Layout *>(impl_.get());
+        }
+
+        static inline bool matches(detail::Subscription &subscription, std::uint64_t now_ns) noexcept
+        {
+            if (++subscription.skipped < subscription.filter.every_nth)
+            {
+                return false;
+            }
+            auto const period = subscription.filter.min_period_ns;
+            if (period != 0)
+            {
+                if (subscription.next_delivery_ns != 0 && now_ns < subscription.next_delivery_ns)
+                {
+                    return false;
+                }
+                // Advance the deadline by whole periods so producer jitter does not lower the rate;
+                // re-anchor on this frame when more than one period behind
+                auto next = (subscription.next_delivery_ns != 0 ? subscription.next_delivery_ns : now_ns) + period;
+                subscription.next_delivery_ns = next > now_ns ? next : now_ns + period;
+            }
+            subscription.skipped = 0;
+            return true;
+        }
+    };
+
+    template <typename T, std::size_t MAX_SUBSCRIBERS = 8, std::size_t SLOTS = 3>
+    struct FlatShmSubscriber
+    {
+        using Layout = typename FlatShmBroadcaster<T, MAX_SUBSCRIBERS, SLOTS>::Layout;
+
+        FlatShmSubscriber(std::string const &shm_name, SubscriptionFilter const &filter)
+            : impl_(shm_name, sizeof(Layout)),
+              sync_(shm_name),
+              index_(claim(filter)),
+              staging_(std::make_unique_for_overwrite<T>())
+        {
+        }
+
+        FlatShmSubscriber(FlatShmSubscriber const &) = delete;
+        FlatShmSubscriber &operator=(FlatShmSubscriber const &) = delete;
+
+        ~FlatShmSubscriber()
+        {
+            layout().subscriptions[index_].state.store(detail::Subscription::FREE, std::memory_order_release);
+        }
+
+        // Blocks until a frame matching the filter is published, then hands a private copy of the
+        // latest frame to consumer; the producer is free to publish while consumer runs
+        template <typename FUNC>
+        void consume(FUNC &&consumer)
+        {
+            wait();
+            sync_.template visit<copy::Memcpy>(latest(), staging_.get(), std::forward<FUNC>(consumer));
+        }
+
+        // Blocking copy of the next matching frame into out
+        void load(T &out)
+        {
+            wait();
+            sync_.template visit<copy::Memcpy>(latest(), &out, [](T const &) {});
+        }
+
+        // Sequence number of the last frame the producer delivered to this subscriber
+        inline std::uint64_t delivered_sequence() noexcept
+        {
+            return layout().subscriptions[index_].delivered_sequence.load(std::memory_order_relaxed);
+        }
+
+        inline std::size_t index() const noexcept
+        {
+            return index_;
+        }
+
+        // Locks / pre-faults the segment and the staging copy callbacks read from
+        rt::RealtimeReport apply_realtime(rt::RealtimeProfile const &profile) noexcept
+        {
+            rt::RealtimeReport report;
+            rt::apply_to_memory(impl_.get(), sizeof(Layout), profile, report);
+            rt::apply_to_memory(staging_.get(), sizeof(T), profile, report);
+            return report;
+        }
+
+    private:
+        shm::Shm impl_;
+        [[no_unique_address]] sync::SeqLock sync_;
+        std::size_t index_;
+        std::unique_ptr<T> staging_;
+
+        inline Layout &layout() noexcept
+        {
+            return *static_cast<Layout *>(impl_.get());
+        }
+
+        // The wake-up lives in the subscription itself, so a reclaimed slot cannot inherit
+        // one addressed to its previous owner
+        inline void wait() noexcept
+        {
+            auto &pending = layout().subscriptions[index_].pending;
+            while (pending.exchange(0, std::memory_order_acq_rel) == 0)
+            {
+                futex::wait(pending, 0);
+            }
+        }
+
+        inline ChannelSlot<T> &latest() noexcept
+        {
+            return layout().slots[layout().sequence.load(std::memory_order_acquire) % SLOTS];
+        }
+
+        // Takes a free slot, or one whose owner process no longer exists
+        std::size_t claim(SubscriptionFilter const &filter)
+        {
+            auto const pid = static_cast<std::uint32_t>(::getpid());
+            for (std::size_t i = 0; i < MAX_SUBSCRIBERS; ++i)
+            {
+                auto &subscription = layout().subscriptions[i];
+                auto owner = subscription.state.load(std::memory_order_acquire);
+                if (owner == detail::Subscription::CLAIMING ||
+                    (owner != detail::Subscription::FREE && (::kill(static_cast<pid_t>(owner), 0) == 0 || errno != ESRCH)))
+                {
+                    continue;
+                }
+                if (!subscription.state.compare_exchange_strong(owner, detail::Subscription::CLAIMING, std::memory_order_acq_rel))
+                {
+                    continue;
+                }
+                subscription.filter = {filter.every_nth ? filter.every_nth : 1, filter.min_period_ns};
+                subscription.skipped = 0;
+                subscription.next_delivery_ns = 0;
+                subscription.pending.store(0, std::memory_order_relaxed);
+                subscription.state.store(pid, std::memory_order_release);
+                return i;
+            }
+            throw std::runtime_error("FlatShmSubscriber: no free subscription slot");
+        }
+    };
+} // namespace flat_shm
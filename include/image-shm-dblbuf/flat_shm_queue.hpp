@@ -0,0 +1,303 @@
+#pragma once
+#include "flat-type/flat.hpp"
+#include "image-shm-dblbuf/futex.hpp"
+#include "image-shm-dblbuf/realtime.hpp"
+#include "shm/shm.hpp"
+#include <array>   // std::array
+#include <atomic>  // std::atomic
+#include <cstdint> // std::uint32_t, std::uint64_t
+#include <span>    // std::span
+#include <string>  // std::string
+
+namespace flat_shm
+{
+    namespace detail
+    {
+        template <typename T>
+        struct QueueCell
+        {
+            std::atomic<std::uint64_t> sequence; // position + 1 once filled, position + CAPACITY once free again
+            T data;
+        };
+    } // namespace detail
+
+    // Bounded lock-free queue of FlatType records in one shared memory segment (Vyukov's bounded
+    // MPMC design). Any number of processes may produce; with MULTI_CONSUMER = false exactly one
+    // consumer process may read, which saves the compare-and-swap on the read index. Producers
+    // never block, a full queue is reported to the caller. Consumers can sleep on a futex in the
+    // segment until a record arrives.
+    template <FlatType T, std::size_t CAPACITY, bool MULTI_CONSUMER>
+    struct FlatShmQueue
+    {
+        static_assert(CAPACITY >= 2 && (CAPACITY & (CAPACITY - 1)) == 0, "Queue capacity must be a power of two");
+
+        static constexpr std::size_t capacity = CAPACITY;
+
+        struct Layout
+        {
+            std::atomic<std::uint32_t> state; // UNINITIALIZED, INITIALIZING or READY; the segment starts zero filled
+            alignas(64) std::atomic<std::uint64_t> enqueue_position;
+            alignas(64) std::atomic<std::uint64_t> dequeue_position;
+            alignas(64) std::atomic<std::uint32_t> not_empty; // futex word, bumped when a sleeping consumer must wake
+            std::atomic<std::uint32_t> waiters;
+            alignas(64) std::array<detail::QueueCell<T>, CAPACITY> cells;
+        };
+
+        FlatShmQueue(std::string const &shm_name)
+            : impl_(shm_name, sizeof(Layout))
+        {
+            initialize();
+        }
+
+        // Appends one record, false if the queue is full
+        inline bool try_produce(T const &data) noexcept
+        {
+            return produce_batch(std::span<T const>(&data, 1)) == 1;
+        }
+
+        // Appends as many records as fit, in order, and returns how many were appended
+        std::size_t produce_batch(std::span<T const> data) noexcept
+        {
+            if (data.empty())
+            {
+                return 0;
+            }
+            auto &queue = layout();
+            auto position = queue.enqueue_position.load(std::memory_order_relaxed);
+            std::size_t count = 0;
+            while (true)
+            {
+                count = free_run(position, data.size());
+                if (count == 0)
+                {
+                    auto const current = queue.enqueue_position.load(std::memory_order_relaxed);
+                    if (current == position)
+                    {
+                        return 0; // full
+                    }
+                    position = current;
+                    continue;
+                }
+                if (queue.enqueue_position.compare_exchange_weak(position, position + count, std::memory_order_relaxed))
+                {
+                    break;
+                }
+            }
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                auto &cell = this->cell(position + i);
+                cell.data = data[i];
+                cell.sequence.store(position + i + 1, std::memory_order_release);
+            }
+            wake_consumers();
+            return count;
+        }
+
+        // Hands the oldest record to consumer without copying it out, false if the queue is empty
+        template <typename FUNC>
+        inline bool try_consume(FUNC &&consumer)
+        {
+            std::uint64_t position = 0;
+            if (claim(position, 1) == 0)
+            {
+                return false;
+            }
+            auto &cell = this->cell(position);
+            consumer(static_cast<T const &>(cell.data));
+            cell.sequence.store(position + CAPACITY, std::memory_order_release);
+            return true;
+        }
+
+        // Blocks until a record is available, then hands it to consumer
+        template <typename FUNC>
+        void consume(FUNC &&consumer)
+        {
+            while (!try_consume(consumer))
+            {
+                wait_not_empty();
+            }
+        }
+
+        inline bool try_load(T &out) noexcept
+        {
+            return try_consume([&out](T const &data)
+                               { out = data; });
+        }
+
+        // Copies up to out.size() records, returns how many; 0 if the queue is empty
+        std::size_t try_load_batch(std::span<T> out) noexcept
+        {
+            if (out.empty())
+            {
+                return 0;
+            }
+            std::uint64_t position = 0;
+            auto const count = claim(position, out.size());
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                auto &cell = this->cell(position + i);
+                out[i] = cell.data;
+                cell.sequence.store(position + i + CAPACITY, std::memory_order_release);
+            }
+            return count;
+        }
+
+        // Blocks until at least one record is available, then copies up to out.size() records
+        std::size_t load_batch(std::span<T> out) noexcept
+        {
+            while (true)
+            {
+                if (auto const count = try_load_batch(out); count != 0 || out.empty())
+                {
+                    return count;
+                }
+                wait_not_empty();
+            }
+        }
+
+        // Records enqueued but not yet dequeued; a snapshot, exact only when the queue is idle
+        inline std::size_t size_approx() noexcept
+        {
+            auto const dequeued = layout().dequeue_position.load(std::memory_order_relaxed);
+            auto const enqueued = layout().enqueue_position.load(std::memory_order_relaxed);
+            return enqueued > dequeued ? static_cast<std::size_t>(enqueued - dequeued) : 0;
+        }
+
+        // Locks / pre-faults the segment; pinning and scheduling belong to the producing and
+        // consuming threads, see rt::apply_to_current_thread
+        rt::RealtimeReport apply_realtime(rt::RealtimeProfile const &profile) noexcept
+        {
+            rt::RealtimeReport report;
+            rt::apply_to_memory(impl_.get(), sizeof(Layout), profile, report);
+            return report;
+        }
+
+    private:
+        static constexpr std::uint32_t UNINITIALIZED = 0;
+        static constexpr std::uint32_t INITIALIZING = 1;
+        static constexpr std::uint32_t READY = 2;
+
+        shm::Shm impl_;
+
+        inline Layout &layout() noexcept
+        {
+            return *static_cast<Layout *>(impl_.get());
+        }
+
+        inline detail::QueueCell<T> &cell(std::uint64_t position) noexcept
+        {
+            return layout().cells[position & (CAPACITY - 1)];
+        }
+
+        // The first process to attach numbers the cells, everyone else waits until it is done
+        void initialize() noexcept
+        {
+            auto &queue = layout();
+            auto state = UNINITIALIZED;
+            if (queue.state.compare_exchange_strong(state, INITIALIZING, std::memory_order_acquire))
+            {
+                for (std::size_t i = 0; i < CAPACITY; ++i)
+                {
+                    queue.cells[i].sequence.store(i, std::memory_order_relaxed);
+                }
+                queue.enqueue_position.store(0, std::memory_order_relaxed);
+                queue.dequeue_position.store(0, std::memory_order_relaxed);
+                queue.state.store(READY, std::memory_order_release);
+                futex::wake_all(queue.state);
+                return;
+            }
+            while ((state = queue.state.load(std::memory_order_acquire)) != READY)
+            {
+                futex::wait(queue.state, state);
+            }
+        }
+
+        // Number of consecutive free cells starting at position, at most max
+        inline std::size_t free_run(std::uint64_t position, std::size_t max) noexcept
+        {
+            std::size_t count = 0;
+            while (count < max && cell(position + count).sequence.load(std::memory_order_acquire) == position + count)
+            {
+                ++count;
+            }
+            return count;
+        }
+
+        // Number of consecutive filled cells starting at position, at most max
+        inline std::size_t filled_run(std::uint64_t position, std::size_t max) noexcept
+        {
+            std::size_t count = 0;
+            while (count < max && cell(position + count).sequence.load(std::memory_order_acquire) == position + count + 1)
+            {
+                ++count;
+            }
+            return count;
+        }
+
+        // Reserves up to max filled cells for this consumer, position receives the first one
+        inline std::size_t claim(std::uint64_t &position, std::size_t max) noexcept
+        {
+            auto &queue = layout();
+            position = queue.dequeue_position.load(std::memory_order_relaxed);
+            if constexpr (MULTI_CONSUMER)
+            {
+                while (true)
+                {
+                    auto const count = filled_run(position, max);
+                    if (count == 0)
+                    {
+                        auto const current = queue.dequeue_position.load(std::memory_order_relaxed);
+                        if (current == position)
+                        {
+                            return 0;
+                        }
+                        position = current;
+                        continue;
+                    }
+                    if (queue.dequeue_position.compare_exchange_weak(position, position + count, std::memory_order_relaxed))
+                    {
+                        return count;
+                    }
+                }
+            }
+            else
+            {
+                auto const count = filled_run(position, max);
+                queue.dequeue_position.store(position + count, std::memory_order_relaxed);
+                return count;
+            }
+        }
+
+        // Producer side of the sleep protocol: only pays for the syscall when someone sleeps
+        inline void wake_consumers() noexcept
+        {
+            auto &queue = layout();
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (queue.waiters.load(std::memory_order_relaxed) != 0)
+            {
+                queue.not_empty.fetch_add(1, std::memory_order_relaxed);
+                futex::wake_all(queue.not_empty);
+            }
+        }
+
+        // Consumer side: announce the sleep, re-check, then wait for a wake-up
+        void wait_not_empty() noexcept
+        {
+            auto &queue = layout();
+            queue.waiters.fetch_add(1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            auto const word = queue.not_empty.load(std::memory_order_relaxed);
+            if (filled_run(queue.dequeue_position.load(std::memory_order_relaxed), 1) == 0)
+            {
+                futex::wait(queue.not_empty, word);
+            }
+            queue.waiters.fetch_sub(1, std::memory_order_relaxed);
+        }
+    };
+
+    template <FlatType T, std::size_t CAPACITY>
+    using MpscQueue = FlatShmQueue<T, CAPACITY, false>;
+
+    template <FlatType T, std::size_t CAPACITY>
+    using MpmcQueue = FlatShmQueue<T, CAPACITY, true>;
+} // namespace flat_shm
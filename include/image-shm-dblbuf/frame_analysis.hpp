@@ -0,0 +1,434 @@
+#pragma once
+#include "image-shm-dblbuf/image.hpp"
+#include <algorithm> // std::min
+#include <array>     // std::array
+#include <bit>       // std::countr_zero
+#include <cstdint>   // std::uint8_t, std::uint32_t, std::uint64_t
+#include <cstring>   // std::memcpy
+#if defined(__x86_64__)
+#include <emmintrin.h> // _mm_min_epu8, _mm_max_epu8, _mm_sad_epu8
+#include <nmmintrin.h> // _mm_crc32_u64, _mm_crc32_u8
+#include <tmmintrin.h> // _mm_shuffle_epi8
+#endif
+
+namespace img
+{
+    constexpr std::size_t LUMA_HISTOGRAM_BINS = 64;
+
+    // Which metrics the fused kernels compute; all off costs nothing over a plain copy
+    struct AnalysisOptions
+    {
+        bool crc32c = false;    // CRC-32C of the pixel data, for integrity checks
+        bool histogram = false; // luminance histogram, for auto-exposure
+        bool stats = false;     // luminance min / max / mean, for health monitoring
+
+        inline bool any() const noexcept
+        {
+            return crc32c || histogram || stats;
+        }
+    };
+
+    struct FrameAnalysis
+    {
+        AnalysisOptions computed; // which of the fields below are valid
+        std::uint8_t luma_min;
+        std::uint8_t luma_max;
+        std::uint32_t crc32c;
+        double luma_mean;
+        std::array<std::uint32_t, LUMA_HISTOGRAM_BINS> luma_histogram;
+    };
+
+    namespace detail
+    {
+        // Castagnoli polynomial, reflected; tables for slicing-by-8
+        constexpr std::array<std::array<std::uint32_t, 256>, 8> make_crc32c_tables() noexcept
+        {
+            std::array<std::array<std::uint32_t, 256>, 8> tables{};
+            for (std::uint32_t i = 0; i < 256; ++i)
+            {
+                auto crc = i;
+                for (int bit = 0; bit < 8; ++bit)
+                {
+                    crc = (crc >> 1) ^ (0x82F63B78u & (0u - (crc & 1u)));
+                }
+                tables[0][i] = crc;
+            }
+            for (std::size_t k = 1; k < 8; ++k)
+            {
+                for (std::size_t i = 0; i < 256; ++i)
+                {
+                    tables[k][i] = (tables[k - 1][i] >> 8) ^ tables[0][tables[k - 1][i] & 0xFF];
+                }
+            }
+            return tables;
+        }
+
+        inline constexpr auto crc32c_tables = make_crc32c_tables();
+
+        inline std::uint32_t crc32c_update_table(std::uint32_t crc, std::uint8_t const *data, std::size_t size) noexcept
+        {
+            auto const &t = crc32c_tables;
+            for (; size >= 8; size -= 8, data += 8)
+            {
+                std::uint32_t low, high;
+                std::memcpy(&low, data, sizeof(low));
+                std::memcpy(&high, data + 4, sizeof(high));
+                low ^= crc;
+                crc = t[7][low & 0xFF] ^ t[6][(low >> 8) & 0xFF] ^ t[5][(low >> 16) & 0xFF] ^ t[4][low >> 24] ^
+                      t[3][high & 0xFF] ^ t[2][(high >> 8) & 0xFF] ^ t[1][(high >> 16) & 0xFF] ^ t[0][high >> 24];
+            }
+            for (; size; --size, ++data)
+            {
+                crc = t[0][(crc ^ *data) & 0xFF] ^ (crc >> 8);
+            }
+            return crc;
+        }
+
+#if defined(__x86_64__) && defined(__GNUC__)
+        // Built for SSE4.2 regardless of the target flags, only called after a CPU check
+        __attribute__((target("sse4.2"))) inline std::uint32_t crc32c_update_sse42(std::uint32_t crc, std::uint8_t const *data, std::size_t size) noexcept
+        {
+            std::uint64_t crc64 = crc;
+            for (; size >= 8; size -= 8, data += 8)
+            {
+                std::uint64_t word;
+                std::memcpy(&word, data, sizeof(word));
+                crc64 = _mm_crc32_u64(crc64, word);
+            }
+            crc = static_cast<std::uint32_t>(crc64);
+            for (; size; --size, ++data)
+            {
+                crc = _mm_crc32_u8(crc, *data);
+            }
+            return crc;
+        }
+
+        inline bool has_sse42() noexcept
+        {
+            static bool const supported = __builtin_cpu_supports("sse4.2");
+            return supported;
+        }
+#endif
+
+        // Pixels per fused block: source, destination and luma scratch stay in L1 while a block is analyzed
+        constexpr std::size_t ANALYSIS_BLOCK_PIXELS = 2048;
+
+        struct LumaAccumulator
+        {
+            std::uint64_t sum = 0;
+            std::uint64_t count = 0;
+            std::uint8_t min = UINT8_MAX;
+            std::uint8_t max = 0;
+            // Four interleaved copies so runs of equal values do not serialize on one counter
+            std::array<std::array<std::uint32_t, LUMA_HISTOGRAM_BINS>, 4> histograms{};
+
+            inline void add(std::uint8_t const *luma, std::size_t n, AnalysisOptions const &options) noexcept
+            {
+                if (options.stats)
+                {
+                    add_stats(luma, n);
+                }
+                if (options.histogram)
+                {
+                    add_histogram(luma, n);
+                }
+                count += n;
+            }
+
+            inline void add_histogram(std::uint8_t const *luma, std::size_t n) noexcept
+            {
+                constexpr unsigned shift = std::countr_zero(256 / LUMA_HISTOGRAM_BINS);
+                std::size_t i = 0;
+                for (; i + 4 <= n; i += 4)
+                {
+                    ++histograms[0][luma[i] >> shift];
+                    ++histograms[1][luma[i + 1] >> shift];
+                    ++histograms[2][luma[i + 2] >> shift];
+                    ++histograms[3][luma[i + 3] >> shift];
+                }
+                for (; i < n; ++i)
+                {
+                    ++histograms[0][luma[i] >> shift];
+                }
+            }
+
+            inline void add_stats(std::uint8_t const *luma, std::size_t n) noexcept
+            {
+                std::size_t i = 0;
+#if defined(__x86_64__)
+                auto vmin = _mm_set1_epi8(static_cast<char>(min));
+                auto vmax = _mm_set1_epi8(static_cast<char>(max));
+                auto vsum = _mm_setzero_si128();
+                for (; i + 16 <= n; i += 16)
+                {
+                    auto const v = _mm_loadu_si128(reinterpret_cast<__m128i const *>(luma + i));
+                    vmin = _mm_min_epu8(vmin, v);
+                    vmax = _mm_max_epu8(vmax, v);
+                    vsum = _mm_add_epi64(vsum, _mm_sad_epu8(v, _mm_setzero_si128()));
+                }
+                alignas(16) std::array<std::uint8_t, 16> lanes_min, lanes_max;
+                alignas(16) std::array<std::uint64_t, 2> sums;
+                _mm_store_si128(reinterpret_cast<__m128i *>(lanes_min.data()), vmin);
+                _mm_store_si128(reinterpret_cast<__m128i *>(lanes_max.data()), vmax);
+                _mm_store_si128(reinterpret_cast<__m128i *>(sums.data()), vsum);
+                min = *std::min_element(lanes_min.begin(), lanes_min.end());
+                max = *std::max_element(lanes_max.begin(), lanes_max.end());
+                sum += sums[0] + sums[1];
+#endif
+                for (; i < n; ++i)
+                {
+                    sum += luma[i];
+                    min = std::min(min, luma[i]);
+                    max = std::max(max, luma[i]);
+                }
+            }
+
+            inline std::array<std::uint32_t, LUMA_HISTOGRAM_BINS> histogram() const noexcept
+            {
+                std::array<std::uint32_t, LUMA_HISTOGRAM_BINS> merged{};
+                for (std::size_t bin = 0; bin < LUMA_HISTOGRAM_BINS; ++bin)
+                {
+                    merged[bin] = histograms[0][bin] + histograms[1][bin] + histograms[2][bin] + histograms[3][bin];
+                }
+                return merged;
+            }
+        };
+
+        // BT.601 luma in 8.8 fixed point
+        template <std::size_t CHANNELS>
+        inline void rgb_to_luma(std::uint8_t const *pixels, std::size_t n, std::uint8_t *luma) noexcept
+        {
+            for (std::size_t i = 0; i < n; ++i)
+            {
+                auto const *p = pixels + i * CHANNELS;
+                luma[i] = static_cast<std::uint8_t>((77u * p[0] + 150u * p[1] + 29u * p[2] + 128u) >> 8);
+            }
+        }
+
+#if defined(__x86_64__) && defined(__GNUC__)
+        // pshufb controls gathering channel c of 16 interleaved pixels from load k of the CHANNELS
+        // 16-byte loads covering them; 0x80 zeroes the lanes another load fills
+        template <std::size_t CHANNELS>
+        constexpr auto make_deinterleave_masks() noexcept
+        {
+            std::array<std::array<std::array<std::uint8_t, 16>, CHANNELS>, 3> masks{};
+            for (std::size_t c = 0; c < 3; ++c)
+            {
+                for (std::size_t k = 0; k < CHANNELS; ++k)
+                {
+                    for (std::size_t pixel = 0; pixel < 16; ++pixel)
+                    {
+                        auto const byte = pixel * CHANNELS + c;
+                        masks[c][k][pixel] = byte / 16 == k ? static_cast<std::uint8_t>(byte % 16) : std::uint8_t{0x80};
+                    }
+                }
+            }
+            return masks;
+        }
+
+        template <std::size_t CHANNELS>
+        inline constexpr auto deinterleave_masks = make_deinterleave_masks<CHANNELS>();
+
+        // Same fixed point luma as rgb_to_luma, 16 pixels per iteration. The weights sum to 256, so
+        // every weighted sum fits a 16-bit lane. With STATS, min / max / sum are accumulated while
+        // the luma is still in registers. Returns how many pixels were converted, a multiple of 16.
+        template <std::size_t CHANNELS, bool STATS>
+        __attribute__((target("ssse3"))) inline std::size_t rgb_to_luma_ssse3(std::uint8_t const *pixels, std::size_t n, std::uint8_t *luma,
+                                                                              LumaAccumulator &accumulator) noexcept
+        {
+            auto const &masks = deinterleave_masks<CHANNELS>;
+            auto const zero = _mm_setzero_si128();
+            auto const weight_r = _mm_set1_epi16(77);
+            auto const weight_g = _mm_set1_epi16(150);
+            auto const weight_b = _mm_set1_epi16(29);
+            auto const round = _mm_set1_epi16(128);
+            auto vmin = _mm_set1_epi8(static_cast<char>(accumulator.min));
+            auto vmax = _mm_set1_epi8(static_cast<char>(accumulator.max));
+            auto vsum = _mm_setzero_si128();
+
+            std::size_t i = 0;
+            for (; i + 16 <= n; i += 16)
+            {
+                auto const *block = reinterpret_cast<__m128i const *>(pixels + i * CHANNELS);
+                auto const load0 = _mm_loadu_si128(block);
+                auto const load1 = _mm_loadu_si128(block + 1);
+                auto const load2 = _mm_loadu_si128(block + 2);
+                // planar channel c of the 16 pixels
+                auto const plane = [&](std::size_t c) __attribute__((always_inline, target("ssse3")))
+                {
+                    auto const *mask = reinterpret_cast<__m128i const *>(masks[c].data());
+                    auto p = _mm_or_si128(_mm_shuffle_epi8(load0, _mm_loadu_si128(mask)), _mm_shuffle_epi8(load1, _mm_loadu_si128(mask + 1)));
+                    p = _mm_or_si128(p, _mm_shuffle_epi8(load2, _mm_loadu_si128(mask + 2)));
+                    if constexpr (CHANNELS == 4)
+                    {
+                        p = _mm_or_si128(p, _mm_shuffle_epi8(_mm_loadu_si128(block + 3), _mm_loadu_si128(mask + 3)));
+                    }
+                    return p;
+                };
+                auto const r = plane(0);
+                auto const g = plane(1);
+                auto const b = plane(2);
+                auto const weigh = [&](__m128i r16, __m128i g16, __m128i b16) __attribute__((always_inline, target("ssse3")))
+                {
+                    auto y16 = _mm_add_epi16(_mm_mullo_epi16(r16, weight_r), _mm_mullo_epi16(g16, weight_g));
+                    y16 = _mm_add_epi16(y16, _mm_mullo_epi16(b16, weight_b));
+                    return _mm_srli_epi16(_mm_add_epi16(y16, round), 8);
+                };
+                auto const low = weigh(_mm_unpacklo_epi8(r, zero), _mm_unpacklo_epi8(g, zero), _mm_unpacklo_epi8(b, zero));
+                auto const high = weigh(_mm_unpackhi_epi8(r, zero), _mm_unpackhi_epi8(g, zero), _mm_unpackhi_epi8(b, zero));
+                auto const y = _mm_packus_epi16(low, high);
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(luma + i), y);
+                if constexpr (STATS)
+                {
+                    vmin = _mm_min_epu8(vmin, y);
+                    vmax = _mm_max_epu8(vmax, y);
+                    vsum = _mm_add_epi64(vsum, _mm_sad_epu8(y, zero));
+                }
+            }
+            if constexpr (STATS)
+            {
+                alignas(16) std::array<std::uint8_t, 16> lanes_min, lanes_max;
+                alignas(16) std::array<std::uint64_t, 2> sums;
+                _mm_store_si128(reinterpret_cast<__m128i *>(lanes_min.data()), vmin);
+                _mm_store_si128(reinterpret_cast<__m128i *>(lanes_max.data()), vmax);
+                _mm_store_si128(reinterpret_cast<__m128i *>(sums.data()), vsum);
+                accumulator.min = *std::min_element(lanes_min.begin(), lanes_min.end());
+                accumulator.max = *std::max_element(lanes_max.begin(), lanes_max.end());
+                accumulator.sum += sums[0] + sums[1];
+            }
+            return i;
+        }
+
+        inline bool has_ssse3() noexcept
+        {
+            static bool const supported = __builtin_cpu_supports("ssse3");
+            return supported;
+        }
+#endif
+
+        // Converts a block of RGB / RGBA pixels to luma in scratch and accumulates it. The SIMD
+        // kernel, when the CPU has it, computes the stats in the conversion loop; the scalar tail
+        // and fallback take them in a second pass over scratch, which is still in L1.
+        template <std::size_t CHANNELS>
+        inline void add_rgb(LumaAccumulator &accumulator, std::uint8_t const *pixels, std::size_t n, std::uint8_t *scratch,
+                            AnalysisOptions const &options) noexcept
+        {
+            std::size_t converted = 0;
+#if defined(__x86_64__) && defined(__GNUC__)
+            if (has_ssse3())
+            {
+                converted = options.stats ? rgb_to_luma_ssse3<CHANNELS, true>(pixels, n, scratch, accumulator)
+                                          : rgb_to_luma_ssse3<CHANNELS, false>(pixels, n, scratch, accumulator);
+            }
+#endif
+            rgb_to_luma<CHANNELS>(pixels + converted * CHANNELS, n - converted, scratch + converted);
+            if (options.stats)
+            {
+                accumulator.add_stats(scratch + converted, n - converted);
+            }
+            if (options.histogram)
+            {
+                accumulator.add_histogram(scratch, n);
+            }
+            accumulator.count += n;
+        }
+    } // namespace detail
+
+    // Hardware CRC32 instruction when the CPU has it, slicing-by-8 tables otherwise
+    inline std::uint32_t crc32c_update(std::uint32_t crc, std::uint8_t const *data, std::size_t size) noexcept
+    {
+#if defined(__x86_64__) && defined(__GNUC__)
+        if (detail::has_sse42())
+        {
+            return detail::crc32c_update_sse42(crc, data, size);
+        }
+#endif
+        return detail::crc32c_update_table(crc, data, size);
+    }
+
+    inline std::uint32_t crc32c(std::uint8_t const *data, std::size_t size) noexcept
+    {
+        return ~crc32c_update(~0u, data, size);
+    }
+
+    // Copies src into dst block by block and analyzes each block right after it was copied,
+    // while it is still in L1, so the metrics cost no extra pass over memory. dst may be null
+    // to only analyze. For NV12 the luminance metrics use the Y plane, the CRC covers both planes.
+    template <typename IMAGE>
+    FrameAnalysis copy_and_analyze(IMAGE *dst, IMAGE const &src, AnalysisOptions const &options) noexcept
+    {
+        if (dst)
+        {
+            dst->timestamp = src.timestamp;
+            dst->frame_number = src.frame_number;
+        }
+        if (!options.any())
+        {
+            if (dst)
+            {
+                std::memcpy(dst->data.data(), src.data.data(), IMAGE::size);
+            }
+            return FrameAnalysis{};
+        }
+
+        constexpr bool planar = IMAGE::type == ImageType::NV12;
+        constexpr std::size_t pixel_bytes = planar ? 1 : static_cast<std::size_t>(channels(IMAGE::type));
+        constexpr std::size_t block_bytes = detail::ANALYSIS_BLOCK_PIXELS * pixel_bytes;
+        constexpr std::size_t luma_bytes = planar ? IMAGE::width * IMAGE::height : IMAGE::size;
+        bool const luma = options.histogram || options.stats;
+
+        std::uint32_t crc = ~0u;
+        detail::LumaAccumulator accumulator;
+        std::array<std::uint8_t, detail::ANALYSIS_BLOCK_PIXELS> scratch;
+        for (std::size_t offset = 0; offset < IMAGE::size; offset += block_bytes)
+        {
+            auto const bytes = std::min(block_bytes, IMAGE::size - offset);
+            auto const *block = src.data.data() + offset;
+            if (dst)
+            {
+                std::memcpy(dst->data.data() + offset, block, bytes);
+                block = dst->data.data() + offset;
+            }
+            if (options.crc32c)
+            {
+                crc = crc32c_update(crc, block, bytes);
+            }
+            if (luma && offset < luma_bytes)
+            {
+                auto const pixels = std::min(bytes, luma_bytes - offset) / pixel_bytes;
+                if constexpr (planar)
+                {
+                    accumulator.add(block, pixels, options);
+                }
+                else
+                {
+                    detail::add_rgb<pixel_bytes>(accumulator, block, pixels, scratch.data(), options);
+                }
+            }
+        }
+
+        FrameAnalysis analysis{};
+        analysis.computed = options;
+        if (options.crc32c)
+        {
+            analysis.crc32c = ~crc;
+        }
+        if (options.stats)
+        {
+            analysis.luma_min = accumulator.min;
+            analysis.luma_max = accumulator.max;
+            analysis.luma_mean = static_cast<double>(accumulator.sum) / static_cast<double>(accumulator.count);
+        }
+        if (options.histogram)
+        {
+            analysis.luma_histogram = accumulator.histogram();
+        }
+        return analysis;
+    }
+
+    template <typename IMAGE>
+    inline FrameAnalysis analyze(IMAGE const &image, AnalysisOptions const &options) noexcept
+    {
+        return copy_and_analyze<IMAGE>(nullptr, image, options);
+    }
+} // namespace img
@@ -0,0 +1,89 @@
+#pragma once
+#include "image-shm-dblbuf/frame_analysis.hpp"
+#include <algorithm> // std::min
+#include <array>   // std::array
+#include <atomic>  // std::atomic, std::atomic_thread_fence
+#include <chrono>  // std::chrono::system_clock
+#include <cstddef> // std::byte
+#include <cstdint> // std::uint64_t
+#include <cstring> // std::memcpy
+#include <span>    // std::span
+
+namespace img
+{
+    constexpr std::size_t USER_METADATA_SIZE = 192;
+
+    // Per-frame metadata published next to, but separate from, the pixel payload. Polling it
+    // costs a few cache lines instead of a full frame copy.
+    struct FrameMetadata
+    {
+        uint64_t sequence;        // incremented on every publish, 0 means nothing published yet
+        uint64_t timestamp;       // image timestamp
+        uint64_t frame_number;    // image frame number
+        uint64_t publish_time_ns; // CLOCK_REALTIME when the frame was published
+        uint32_t user_size;       // bytes used in user
+        uint32_t reserved;
+        std::array<std::byte, USER_METADATA_SIZE> user; // exposure, camera pose, detections, ...
+        FrameAnalysis analysis;                         // metrics computed while the frame was stored
+    };
+
+    // Seqlock protected metadata block on its own cache lines: one writer, any number of readers,
+    // readers never block the writer and retry if they raced with a publish.
+    struct alignas(64) MetadataSlot
+    {
+        std::atomic<uint64_t> version; // odd while a publish is in progress
+        FrameMetadata metadata;
+
+        inline void publish(uint64_t timestamp, uint64_t frame_number, std::span<std::byte const> user = {},
+                            FrameAnalysis const &analysis = {}) noexcept
+        {
+            auto const version_before = version.load(std::memory_order_relaxed);
+            version.store(version_before + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+
+            metadata.sequence = version_before / 2 + 1;
+            metadata.timestamp = timestamp;
+            metadata.frame_number = frame_number;
+            metadata.publish_time_ns = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                                                 std::chrono::system_clock::now().time_since_epoch())
+                                                                 .count());
+            metadata.user_size = static_cast<uint32_t>(std::min(user.size(), USER_METADATA_SIZE));
+            if (metadata.user_size)
+            {
+                std::memcpy(metadata.user.data(), user.data(), metadata.user_size);
+            }
+            metadata.analysis = analysis;
+
+            version.store(version_before + 2, std::memory_order_release);
+        }
+
+        // Consistent snapshot of the last published metadata
+        inline FrameMetadata peek() const noexcept
+        {
+            FrameMetadata snapshot;
+            while (true)
+            {
+                auto const version_before = version.load(std::memory_order_acquire);
+                if (version_before & 1)
+                {
+                    continue;
+                }
+                std::memcpy(&snapshot, &metadata, sizeof(snapshot));
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (version.load(std::memory_order_relaxed) == version_before)
+                {
+                    return snapshot;
+                }
+            }
+        }
+
+        // Only reads the version word: cheapest possible "is there anything new" check
+        inline uint64_t sequence() const noexcept
+        {
+            return version.load(std::memory_order_acquire) / 2;
+        }
+    };
+
+    static_assert(sizeof(MetadataSlot) % 64 == 0);
+    static_assert(std::atomic<uint64_t>::is_always_lock_free);
+} // namespace img
@@ -0,0 +1,231 @@
+#pragma once
+#include <algorithm>   // std::find, std::count_if
+#include <cstddef>     // std::size_t
+#include <map>         // std::map
+#include <memory>      // std::unique_ptr, std::shared_ptr
+#include <mutex>       // std::mutex
+#include <new>         // std::bad_alloc, placement new
+#include <sys/mman.h>  // mmap, madvise
+#include <type_traits> // std::is_trivially_default_constructible_v
+#include <vector>      // std::vector
+
+namespace img
+{
+    struct FramePoolOptions
+    {
+        bool huge_pages = false; // MAP_HUGETLB, falls back to transparent huge pages when none are reserved
+        bool prefault = true;    // take the page faults once when a block is mapped instead of on first use
+    };
+
+    struct FramePoolStats
+    {
+        std::size_t block_size;
+        std::size_t blocks;     // blocks mapped by this pool
+        std::size_t free;       // blocks ready to be handed out
+        std::size_t huge_pages; // blocks backed by MAP_HUGETLB
+    };
+
+    // Process-wide, size-classed pool of frame sized blocks. Blocks are mapped once and recycled
+    // without zero fill, so acquiring a frame costs neither page faults nor a 24 MB memset.
+    struct FramePool
+    {
+        static constexpr std::size_t PAGE_SIZE = 4096;
+        static constexpr std::size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+        // One pool per size class; block sizes are rounded up to whole pages. The pools are never
+        // destroyed so frames released during static destruction still have somewhere to go.
+        static FramePool &instance(std::size_t size)
+        {
+            static std::mutex mutex;
+            static auto *pools = new std::map<std::size_t, std::unique_ptr<FramePool>>();
+
+            auto const block_size = round_up(size, PAGE_SIZE);
+            std::lock_guard lock(mutex);
+            auto &pool = (*pools)[block_size];
+            if (!pool)
+            {
+                pool.reset(new FramePool(block_size));
+            }
+            return *pool;
+        }
+
+        template <typename T>
+        static FramePool &of()
+        {
+            static FramePool &pool = instance(sizeof(T));
+            return pool;
+        }
+
+        FramePool(FramePool const &) = delete;
+        FramePool &operator=(FramePool const &) = delete;
+
+        // Applies to blocks mapped after the call
+        void configure(FramePoolOptions const &options)
+        {
+            std::lock_guard lock(mutex_);
+            options_ = options;
+        }
+
+        // Makes sure at least count blocks are free, mapping (and pre-faulting) the missing ones now
+        void reserve(std::size_t count)
+        {
+            std::lock_guard lock(mutex_);
+            while (free_.size() < count)
+            {
+                free_.push_back(map_block());
+            }
+        }
+
+        // Returns uninitialized memory of block_size() bytes
+        void *acquire()
+        {
+            std::lock_guard lock(mutex_);
+            if (free_.empty())
+            {
+                return map_block();
+            }
+            auto *ptr = free_.back();
+            free_.pop_back();
+            return ptr;
+        }
+
+        void release(void *ptr) noexcept
+        {
+            std::lock_guard lock(mutex_);
+            free_.push_back(ptr);
+        }
+
+        // Unmaps every free block
+        void trim() noexcept
+        {
+            std::lock_guard lock(mutex_);
+            std::erase_if(blocks_, [this](Block const &block)
+                          {
+                              auto const it = std::find(free_.begin(), free_.end(), block.ptr);
+                              if (it == free_.end())
+                              {
+                                  return false;
+                              }
+                              free_.erase(it);
+                              ::munmap(block.ptr, block.mapped_size);
+                              return true; });
+        }
+
+        FramePoolStats stats() const
+        {
+            std::lock_guard lock(mutex_);
+            auto const huge = static_cast<std::size_t>(std::count_if(blocks_.begin(), blocks_.end(), [](Block const &block)
+                                                                     { return block.huge; }));
+            return {block_size_, blocks_.size(), free_.size(), huge};
+        }
+
+        inline std::size_t block_size() const noexcept
+        {
+            return block_size_;
+        }
+
+    private:
+        struct Block
+        {
+            void *ptr;
+            std::size_t mapped_size;
+            bool huge;
+        };
+
+        std::size_t block_size_;
+        FramePoolOptions options_;
+        std::vector<Block> blocks_;
+        std::vector<void *> free_;
+        mutable std::mutex mutex_;
+
+        explicit FramePool(std::size_t block_size)
+            : block_size_(block_size)
+        {
+        }
+
+        static constexpr std::size_t round_up(std::size_t size, std::size_t alignment) noexcept
+        {
+            return (size + alignment - 1) / alignment * alignment;
+        }
+
+        void *map_block()
+        {
+            int const populate = options_.prefault ? MAP_POPULATE : 0;
+            if (options_.huge_pages)
+            {
+                auto const size = round_up(block_size_, HUGE_PAGE_SIZE);
+                auto *ptr = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | populate, -1, 0);
+                if (ptr != MAP_FAILED)
+                {
+                    blocks_.push_back({ptr, size, true});
+                    return ptr;
+                }
+            }
+            auto *ptr = ::mmap(nullptr, block_size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (ptr == MAP_FAILED)
+            {
+                throw std::bad_alloc();
+            }
+            if (options_.huge_pages)
+            {
+                ::madvise(ptr, block_size_, MADV_HUGEPAGE);
+            }
+            if (options_.prefault)
+            {
+                prefault(static_cast<std::byte *>(ptr));
+            }
+            blocks_.push_back({ptr, block_size_, false});
+            return ptr;
+        }
+
+        void prefault(std::byte *ptr) const noexcept
+        {
+#ifdef MADV_POPULATE_WRITE
+            if (::madvise(ptr, block_size_, MADV_POPULATE_WRITE) == 0)
+            {
+                return;
+            }
+#endif
+            for (std::size_t offset = 0; offset < block_size_; offset += PAGE_SIZE)
+            {
+                ptr[offset] = std::byte{0};
+            }
+        }
+    };
+
+    template <typename T>
+    struct PoolDeleter
+    {
+        inline void operator()(T *ptr) const noexcept
+        {
+            ptr->~T();
+            FramePool::of<T>().release(ptr);
+        }
+    };
+
+    template <typename T>
+    using pooled_ptr = std::unique_ptr<T, PoolDeleter<T>>;
+
+    // Creates T in a recycled block without zero filling it. The pixel contents of the new frame
+    // are unspecified (indeterminate) and must be written before they are read; the timestamp and
+    // frame number start at 0.
+    template <typename T>
+    pooled_ptr<T> make_pooled()
+    {
+        static_assert(std::is_trivially_default_constructible_v<T> && std::is_trivially_destructible_v<T>,
+                      "Pooled frames are recycled without initialization");
+        auto *ptr = new (FramePool::of<T>().acquire()) T;
+        if constexpr (requires { ptr->timestamp; ptr->frame_number; })
+        {
+            ptr->timestamp = 0;
+            ptr->frame_number = 0;
+        }
+        return pooled_ptr<T>(ptr);
+    }
+
+    template <typename T>
+    std::shared_ptr<T> make_pooled_shared()
+    {
+        return make_pooled<T>();
+    }
+} // namespace img
@@ -0,0 +1,30 @@
+#pragma once
+#include <atomic>         // std::atomic
+#include <cerrno>         // errno
+#include <climits>        // INT_MAX
+#include <cstdint>        // std::uint32_t
+#include <linux/futex.h>  // FUTEX_WAIT, FUTEX_WAKE
+#include <sys/syscall.h>  // SYS_futex
+#include <unistd.h>       // syscall
+
+// Process-shared futex wrappers for 32-bit words living in shared memory
+namespace flat_shm::futex
+{
+    static_assert(sizeof(std::atomic<std::uint32_t>) == sizeof(std::uint32_t));
+
+    // Sleeps while word == expected; returns on wake-up, value change or signal
+    inline void wait(std::atomic<std::uint32_t> &word, std::uint32_t expected) noexcept
+    {
+        ::syscall(SYS_futex, reinterpret_cast<std::uint32_t *>(&word), FUTEX_WAIT, expected, nullptr, nullptr, 0);
+    }
+
+    inline void wake_one(std::atomic<std::uint32_t> &word) noexcept
+    {
+        ::syscall(SYS_futex, reinterpret_cast<std::uint32_t *>(&word), FUTEX_WAKE, 1, nullptr, nullptr, 0);
+    }
+
+    inline void wake_all(std::atomic<std::uint32_t> &word) noexcept
+    {
+        ::syscall(SYS_futex, reinterpret_cast<std::uint32_t *>(&word), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+    }
+} // namespace flat_shm::futex
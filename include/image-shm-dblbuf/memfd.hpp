@@ -0,0 +1,441 @@
+#pragma once
+#include "image-shm-dblbuf/fd.hpp"
+#include "image-shm-dblbuf/realtime.hpp"
+#include <cerrno>      // errno
+#include <cstddef>     // std::size_t
+#include <exception>   // std::exception
+#include <fcntl.h>     // fcntl, F_ADD_SEALS
+#include <fmt/core.h>  // fmt::format
+#include <fstream>     // std::ifstream
+#include <functional>  // std::function
+#include <linux/magic.h> // HUGETLBFS_MAGIC
+#include <linux/memfd.h>
+#include <memory>      // std::unique_ptr
+#include <poll.h>      // poll
+#include <semaphore.h> // sem_t
+#include <stdexcept>   // std::runtime_error
+#include <string>      // std::string
+#include <string_view> // std::string_view
+#include <sys/mman.h>  // memfd_create, mmap
+#include <sys/socket.h>
+#include <sys/stat.h> // fstat
+#include <sys/vfs.h>  // fstatfs
+#include <sys/un.h>   // sockaddr_un
+#include <thread>     // std::jthread
+#include <unistd.h>   // ftruncate
+#include <utility>    // std::exchange
+
+// Anonymous shared memory channels: segments are memfd files that never appear under /dev/shm,
+// and consumers obtain them by receiving the file descriptor over an abstract Unix-domain socket.
+// Nothing is left behind when the last process holding the descriptor exits.
+namespace memfd
+{
+    enum class HugePages : unsigned int
+    {
+        None = 0,
+        Default = MFD_HUGETLB,
+        Size2MB = MFD_HUGETLB | MFD_HUGE_2MB,
+        Size1GB = MFD_HUGETLB | MFD_HUGE_1GB,
+    };
+
+    // Granularity hugetlbfs sizes a segment in, 1 when huge pages are not used
+    inline std::size_t huge_page_size(HugePages huge_pages)
+    {
+        switch (huge_pages)
+        {
+        case HugePages::None:
+            return 1;
+        case HugePages::Size2MB:
+            return std::size_t{2} << 20;
+        case HugePages::Size1GB:
+            return std::size_t{1} << 30;
+        case HugePages::Default:
+            break;
+        }
+        auto meminfo = std::ifstream("/proc/meminfo");
+        std::string key;
+        std::size_t kb = 0;
+        while (meminfo >> key)
+        {
+            if (key == "Hugepagesize:" && meminfo >> kb)
+            {
+                return kb * 1024;
+            }
+        }
+        return std::size_t{2} << 20;
+    }
+
+    inline std::size_t round_up(std::size_t size, std::size_t granularity) noexcept
+    {
+        return (size + granularity - 1) / granularity * granularity;
+    }
+
+    using posix::Fd;
+
+    [[noreturn]] inline void throw_errno(std::string_view what)
+    {
+        posix::throw_errno("memfd", what);
+    }
+
+    struct Segment
+    {
+        static constexpr int SEALS = F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL;
+
+        // Creates a sealed anonymous segment of a fixed size. hugetlbfs only accepts whole huge
+        // pages, so with huge pages the segment is rounded up and size() reports the rounded length.
+        static Segment create(std::string const &name, std::size_t size, HugePages huge_pages = HugePages::None)
+        {
+            size = round_up(size, huge_page_size(huge_pages));
+            auto fd = Fd(::memfd_create(name.c_str(), MFD_CLOEXEC | MFD_ALLOW_SEALING | static_cast<unsigned int>(huge_pages)));
+            if (fd.get() < 0)
+            {
+                throw_errno("memfd_create");
+            }
+            if (::ftruncate(fd.get(), static_cast<off_t>(size)) != 0)
+            {
+                throw_errno("ftruncate");
+            }
+            if (::fcntl(fd.get(), F_ADD_SEALS, SEALS) != 0)
+            {
+                throw_errno("F_ADD_SEALS");
+            }
+            return Segment(std::move(fd), size);
+        }
+
+        // Maps a segment received from another process. The size is taken from the file and must be
+        // expected_size, rounded up to the huge page size when the file lives on hugetlbfs.
+        static Segment open(Fd fd, std::size_t expected_size)
+        {
+            if ((::fcntl(fd.get(), F_GET_SEALS) & SEALS) != SEALS)
+            {
+                throw std::runtime_error("memfd: received segment is not sealed");
+            }
+            struct stat st{};
+            if (::fstat(fd.get(), &st) != 0)
+            {
+                throw_errno("fstat");
+            }
+            struct statfs fs{};
+            if (::fstatfs(fd.get(), &fs) != 0)
+            {
+                throw_errno("fstatfs");
+            }
+            auto const granularity = fs.f_type == HUGETLBFS_MAGIC ? static_cast<std::size_t>(fs.f_bsize) : std::size_t{1};
+            auto const size = static_cast<std::size_t>(st.st_size);
+            if (size < expected_size || size != round_up(expected_size, granularity))
+            {
+                throw std::runtime_error(fmt::format("memfd: segment size {} does not match expected {}", st.st_size, expected_size));
+            }
+            return Segment(std::move(fd), size);
+        }
+
+        Segment(Segment &&other) noexcept
+            : fd_(std::move(other.fd_)),
+              size_(other.size_),
+              ptr_(std::exchange(other.ptr_, nullptr))
+        {
+        }
+
+        Segment &operator=(Segment &&other) noexcept
+        {
+            std::swap(fd_, other.fd_);
+            std::swap(size_, other.size_);
+            std::swap(ptr_, other.ptr_);
+            return *this;
+        }
+
+        ~Segment()
+        {
+            if (ptr_)
+            {
+                ::munmap(ptr_, size_);
+            }
+        }
+
+        inline void *get() const noexcept
+        {
+            return ptr_;
+        }
+
+        inline std::size_t size() const noexcept
+        {
+            return size_;
+        }
+
+        inline int fd() const noexcept
+        {
+            return fd_.get();
+        }
+
+    private:
+        Fd fd_;
+        std::size_t size_;
+        void *ptr_;
+
+        Segment(Fd fd, std::size_t size)
+            : fd_(std::move(fd)), size_(size)
+        {
+            ptr_ = ::mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_.get(), 0);
+            if (ptr_ == MAP_FAILED)
+            {
+                ptr_ = nullptr;
+                throw_errno("mmap");
+            }
+        }
+    };
+
+    inline std::pair<sockaddr_un, socklen_t> abstract_address(std::string const &name)
+    {
+        return posix::abstract_address("memfd", name);
+    }
+
+    inline void send_fd(int socket, int fd)
+    {
+        char byte = 0;
+        iovec iov{&byte, 1};
+        alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))]{};
+        msghdr msg{};
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        auto *cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+        std::memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+        if (::sendmsg(socket, &msg, MSG_NOSIGNAL) != 1)
+        {
+            throw_errno("sendmsg");
+        }
+    }
+
+    inline Fd receive_fd(int socket)
+    {
+        char byte = 0;
+        iovec iov{&byte, 1};
+        alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))]{};
+        msghdr msg{};
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        if (::recvmsg(socket, &msg, MSG_CMSG_CLOEXEC) != 1)
+        {
+            throw_errno("recvmsg");
+        }
+        auto *cmsg = CMSG_FIRSTHDR(&msg);
+        if (!cmsg || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+        {
+            throw std::runtime_error("memfd: handshake did not carry a file descriptor");
+        }
+        int fd = -1;
+        std::memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+        return Fd(fd);
+    }
+
+    // Connects to a Listener and receives its segment descriptor
+    inline Fd connect(std::string const &socket_name)
+    {
+        auto socket = Fd(::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0));
+        if (socket.get() < 0)
+        {
+            throw_errno("socket");
+        }
+        auto const [addr, length] = abstract_address(socket_name);
+        if (::connect(socket.get(), reinterpret_cast<sockaddr const *>(&addr), length) != 0)
+        {
+            throw_errno(fmt::format("connect to '{}'", socket_name));
+        }
+        return receive_fd(socket.get());
+    }
+
+    // Called from the listener thread when handing the descriptor to a client fails; the client
+    // sees its own error, the producer keeps serving
+    using ErrorHandler = std::function<void(std::exception const &)>;
+
+    // Hands a descriptor to every process that connects to the socket name, from a background thread
+    struct Listener
+    {
+        Listener(std::string const &socket_name, int fd, ErrorHandler on_error = {})
+            : socket_(::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)),
+              on_error_(std::move(on_error))
+        {
+            if (socket_.get() < 0)
+            {
+                throw_errno("socket");
+            }
+            auto const [addr, length] = abstract_address(socket_name);
+            if (::bind(socket_.get(), reinterpret_cast<sockaddr const *>(&addr), length) != 0)
+            {
+                throw_errno(fmt::format("bind '{}'", socket_name));
+            }
+            if (::listen(socket_.get(), SOMAXCONN) != 0)
+            {
+                throw_errno("listen");
+            }
+            thread_ = std::jthread([this, fd](std::stop_token stop)
+                                   { serve(stop, fd); });
+        }
+
+    private:
+        Fd socket_;
+        ErrorHandler on_error_;
+        std::jthread thread_;
+
+        void serve(std::stop_token const &stop, int fd) noexcept
+        {
+            while (!stop.stop_requested())
+            {
+                pollfd pfd{socket_.get(), POLLIN, 0};
+                if (::poll(&pfd, 1, 50) <= 0)
+                {
+                    continue;
+                }
+                auto client = Fd(::accept4(socket_.get(), nullptr, nullptr, SOCK_CLOEXEC));
+                if (client.get() < 0)
+                {
+                    continue;
+                }
+                try
+                {
+                    send_fd(client.get(), fd);
+                }
+                catch (std::exception const &e)
+                {
+                    if (on_error_)
+                    {
+                        on_error_(e);
+                    }
+                }
+            }
+        }
+    };
+
+    // memfd counterpart of flat_shm::FlatShmProducerConsumer: the handshake semaphores are
+    // process-shared and live inside the segment, so the channel has no global names at all.
+    template <typename T>
+    struct FlatChannel
+    {
+        // Producer side: owns the segment and serves it on socket_name; on_error reports failed handshakes
+        static FlatChannel create(std::string const &socket_name, HugePages huge_pages = HugePages::None,
+                                  ErrorHandler on_error = {})
+        {
+            return FlatChannel(socket_name, huge_pages, std::move(on_error));
+        }
+
+        // Consumer side: receives the segment from the producer serving socket_name
+        static FlatChannel connect(std::string const &socket_name)
+        {
+            return FlatChannel(Segment::open(memfd::connect(socket_name), sizeof(Layout)));
+        }
+
+        // Ownership of the semaphores moves with the segment; the source no longer destroys them
+        FlatChannel(FlatChannel &&other) noexcept
+            : segment_(std::move(other.segment_)),
+              listener_(std::move(other.listener_)),
+              owner_(std::exchange(other.owner_, false))
+        {
+        }
+
+        FlatChannel &operator=(FlatChannel &&other) noexcept
+        {
+            if (this != &other)
+            {
+                release();
+                segment_ = std::move(other.segment_);
+                listener_ = std::move(other.listener_);
+                owner_ = std::exchange(other.owner_, false);
+            }
+            return *this;
+        }
+
+        ~FlatChannel()
+        {
+            release();
+        }
+
+        inline void produce(T const &data)
+        {
+            wait(layout().sem_write);
+            layout().data = data;
+            sem_post(&layout().sem_read);
+        }
+
+        inline T const &consume_unsafe()
+        {
+            return layout().data;
+        }
+
+        template <typename FUNC>
+        void consume(FUNC &&consumer)
+        {
+            wait(layout().sem_read);
+            consumer(static_cast<T const &>(layout().data));
+            sem_post(&layout().sem_write);
+        }
+
+        inline int fd() const noexcept
+        {
+            return segment_.fd();
+        }
+
+        // Locks / pre-faults the mapped segment, including any huge page rounding; pinning and
+        // scheduling belong to the threads calling produce / consume, see rt::apply_to_current_thread
+        rt::RealtimeReport apply_realtime(rt::RealtimeProfile const &profile) noexcept
+        {
+            rt::RealtimeReport report;
+            rt::apply_to_memory(segment_.get(), segment_.size(), profile, report);
+            return report;
+        }
+
+    private:
+        struct Layout
+        {
+            sem_t sem_read;
+            sem_t sem_write;
+            T data;
+        };
+
+        Segment segment_;
+        std::unique_ptr<Listener> listener_;
+        bool owner_ = false;
+
+        FlatChannel(std::string const &socket_name, HugePages huge_pages, ErrorHandler on_error)
+            : segment_(Segment::create(socket_name, sizeof(Layout), huge_pages)),
+              owner_(true)
+        {
+            sem_init(&layout().sem_read, 1, 0);
+            sem_init(&layout().sem_write, 1, 1);
+            listener_ = std::make_unique<Listener>(socket_name, segment_.fd(), std::move(on_error));
+        }
+
+        explicit FlatChannel(Segment segment)
+            : segment_(std::move(segment))
+        {
+        }
+
+        inline Layout &layout() noexcept
+        {
+            return *static_cast<Layout *>(segment_.get());
+        }
+
+        // Stops serving the segment and destroys the semaphores if this channel created them
+        void release() noexcept
+        {
+            listener_.reset();
+            if (std::exchange(owner_, false) && segment_.get())
+            {
+                sem_destroy(&layout().sem_read);
+                sem_destroy(&layout().sem_write);
+            }
+        }
+
+        static inline void wait(sem_t &sem) noexcept
+        {
+            while (sem_wait(&sem) != 0 && errno == EINTR)
+            {
+            }
+        }
+    };
+} // namespace memfd
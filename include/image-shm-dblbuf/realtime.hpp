@@ -0,0 +1,169 @@
+#pragma once
+#include <cerrno>        // errno
+#include <cstddef>       // std::byte
+#include <cstdint>       // std::uint32_t, std::uint64_t
+#include <cstring>       // std::strerror
+#include <fmt/core.h>    // fmt::format
+#include <pthread.h>     // pthread_setaffinity_np, pthread_setschedparam
+#include <sched.h>       // cpu_set_t, SCHED_FIFO
+#include <string>        // std::string
+#include <sys/mman.h>    // mlock, madvise
+#include <sys/syscall.h> // SYS_sched_setattr
+#include <unistd.h>      // syscall, sysconf
+#include <vector>        // std::vector
+
+// Deployment profile against scheduler and page-fault jitter: CPU pinning, real-time scheduling
+// and locked, pre-faulted segments. Every setting is best effort, unprivileged processes get a
+// report of what was refused instead of an exception.
+namespace rt
+{
+    enum class SchedulingPolicy
+    {
+        OTHER,    // leave the default time-sharing policy
+        FIFO,     // SCHED_FIFO at priority, needs CAP_SYS_NICE or an RLIMIT_RTPRIO allowance
+        DEADLINE, // SCHED_DEADLINE with runtime / deadline / period, needs CAP_SYS_NICE
+    };
+
+    struct RealtimeProfile
+    {
+        std::vector<int> cpus;                             // allowed CPUs, empty keeps the current affinity
+        SchedulingPolicy policy = SchedulingPolicy::OTHER;
+        int priority = 50;                                 // SCHED_FIFO priority, 1 - 99
+        std::uint64_t runtime_ns = 0;                      // SCHED_DEADLINE budget per period
+        std::uint64_t deadline_ns = 0;                     // SCHED_DEADLINE relative deadline, 0 means period
+        std::uint64_t period_ns = 0;                       // SCHED_DEADLINE period
+        bool lock_memory = false;                          // mlock segments so they cannot be swapped out
+        bool prefault = false;                             // fault segment pages in up front
+    };
+
+    struct SettingStatus
+    {
+        bool requested = false;
+        bool applied = false;
+        int error = 0; // errno of the first failure
+
+        inline std::string to_string() const
+        {
+            if (!requested)
+            {
+                return "not requested";
+            }
+            return applied ? "ok" : fmt::format("failed ({})", std::strerror(error));
+        }
+    };
+
+    struct RealtimeReport
+    {
+        SettingStatus affinity;
+        SettingStatus scheduling;
+        SettingStatus memory_lock;
+        SettingStatus prefault;
+
+        inline std::string summary() const
+        {
+            return fmt::format("affinity: {}, scheduling: {}, memory lock: {}, prefault: {}",
+                               affinity.to_string(), scheduling.to_string(), memory_lock.to_string(), prefault.to_string());
+        }
+    };
+
+    namespace detail
+    {
+        constexpr std::uint32_t SCHED_DEADLINE_POLICY = 6;
+
+        // Kernel ABI of sched_setattr(2), not exposed by every libc
+        struct SchedAttr
+        {
+            std::uint32_t size;
+            std::uint32_t sched_policy;
+            std::uint64_t sched_flags;
+            std::int32_t sched_nice;
+            std::uint32_t sched_priority;
+            std::uint64_t sched_runtime;
+            std::uint64_t sched_deadline;
+            std::uint64_t sched_period;
+        };
+
+        inline void record(SettingStatus &status, int result) noexcept
+        {
+            status.requested = true;
+            if (result != 0 && status.error == 0)
+            {
+                status.error = result;
+            }
+            status.applied = status.error == 0;
+        }
+    } // namespace detail
+
+    // Affinity and scheduling policy of the calling thread
+    inline RealtimeReport apply_to_current_thread(RealtimeProfile const &profile) noexcept
+    {
+        RealtimeReport report;
+        if (!profile.cpus.empty())
+        {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            for (auto cpu : profile.cpus)
+            {
+                if (cpu >= 0 && cpu < CPU_SETSIZE)
+                {
+                    CPU_SET(static_cast<std::size_t>(cpu), &set);
+                }
+            }
+            detail::record(report.affinity, ::pthread_setaffinity_np(::pthread_self(), sizeof(set), &set));
+        }
+
+        if (profile.policy == SchedulingPolicy::FIFO)
+        {
+            sched_param param{};
+            param.sched_priority = profile.priority;
+            detail::record(report.scheduling, ::pthread_setschedparam(::pthread_self(), SCHED_FIFO, &param));
+        }
+        else if (profile.policy == SchedulingPolicy::DEADLINE)
+        {
+#ifdef SYS_sched_setattr
+            detail::SchedAttr attr{};
+            attr.size = sizeof(attr);
+            attr.sched_policy = detail::SCHED_DEADLINE_POLICY;
+            attr.sched_runtime = profile.runtime_ns;
+            attr.sched_deadline = profile.deadline_ns ? profile.deadline_ns : profile.period_ns;
+            attr.sched_period = profile.period_ns;
+            detail::record(report.scheduling, ::syscall(SYS_sched_setattr, 0, &attr, 0) == 0 ? 0 : errno);
+#else
+            detail::record(report.scheduling, ENOSYS);
+#endif
+        }
+        return report;
+    }
+
+    // Locks and / or pre-faults one mapped segment; call once per segment, results accumulate in report
+    inline void apply_to_memory(void *address, std::size_t size, RealtimeProfile const &profile, RealtimeReport &report) noexcept
+    {
+        if (!address || size == 0)
+        {
+            return;
+        }
+        if (profile.prefault)
+        {
+#ifdef MADV_POPULATE_WRITE
+            // page align down, madvise requires it
+            auto const page = static_cast<std::uintptr_t>(::sysconf(_SC_PAGESIZE));
+            auto const begin = reinterpret_cast<std::uintptr_t>(address) & ~(page - 1);
+            auto const length = reinterpret_cast<std::uintptr_t>(address) + size - begin;
+            detail::record(report.prefault, ::madvise(reinterpret_cast<void *>(begin), length, MADV_POPULATE_WRITE) == 0 ? 0 : errno);
+#else
+            // Reading is enough to map the pages; writing could race with another process's data
+            auto const page = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+            auto const *bytes = static_cast<std::byte const volatile *>(address);
+            for (std::size_t offset = 0; offset < size; offset += page)
+            {
+                (void)bytes[offset];
+            }
+            detail::record(report.prefault, 0);
+#endif
+        }
+        if (profile.lock_memory)
+        {
+            detail::record(report.memory_lock, ::mlock(address, size) == 0 ? 0 : errno);
+        }
+    }
+} // namespace rt
@@ -1,10 +1,17 @@
 #pragma once
 #include "double-buffer-swapper/swapper.hpp"
+#include "image-shm-dblbuf/frame_analysis.hpp"
+#include "image-shm-dblbuf/frame_metadata.hpp"
+#include "image-shm-dblbuf/frame_pool.hpp"
 #include "image-shm-dblbuf/image.hpp"
+#include "image-shm-dblbuf/realtime.hpp"
 #include "shm/semaphore.hpp"
 #include "shm/shm.hpp"
 #include "single-task-runner/runner.hpp"
+#include <atomic>
 #include <fmt/core.h>
+#include <mutex>
+#include <optional>
 
 using Image = img::Image4K_RGB;
 
@@ -30,23 +37,34 @@ void log(std::string_view msg) noexcept
 struct DoubleBufferShem
 {
     shm::Shm shm_;
+    shm::Shm meta_shm_;
     shm::Semaphore sem_;
-    std::unique_ptr<Image> pre_allocated_;
+    img::pooled_ptr<Image> pre_allocated_;
     std::unique_ptr<DoubleBufferSwapper<Image>> swapper_;
     std::unique_ptr<run::SingleTaskRunner> runner_;
     Image *img_ptr_;
     ReturnImage return_image_;
+    img::AnalysisOptions analysis_;
+    rt::RealtimeProfile realtime_profile_;
+    std::atomic<bool> realtime_pending_ = false;
+    mutable std::mutex realtime_mutex_;
+    rt::RealtimeReport realtime_report_;
 
     DoubleBufferShem(std::string const &shm_name)
         : shm_(shm::path(shm_name), sizeof(Image)),
+          meta_shm_(shm::path(shm_name + "_meta"), sizeof(img::MetadataSlot)),
           sem_(shm_name + "_sem", 1),
-          pre_allocated_(std::make_unique<Image>()),
+          pre_allocated_(img::make_pooled<Image>()),
           img_ptr_(nullptr),
           return_image_{&img_ptr_}
     {
         swapper_ = std::make_unique<DoubleBufferSwapper<Image>>(&img_ptr_, pre_allocated_.get());
         runner_ = std::make_unique<run::SingleTaskRunner>([&]
                                                           {
+                                                            if (realtime_pending_.exchange(false, std::memory_order_acquire))
+                                                            {
+                                                                apply_realtime_to_runner();
+                                                            }
                                                             sem_.wait();
                                                             swapper_->swap();
                                                             sem_.post(); },
@@ -63,13 +81,59 @@ struct DoubleBufferShem
         return_image_.img_ptr_ = nullptr;
     }
 
-    void store(Image const &image)
+    // Metrics computed during store() and published in the frame metadata
+    void set_analysis(img::AnalysisOptions const &options) noexcept
     {
+        analysis_ = options;
+    }
+
+    // Locks / pre-faults the segments now; pinning and scheduling are applied by the runner
+    // thread itself at the start of the next load()
+    rt::RealtimeReport apply_realtime(rt::RealtimeProfile const &profile)
+    {
+        std::lock_guard lock(realtime_mutex_);
+        realtime_report_ = {};
+        rt::apply_to_memory(shm_.get(), sizeof(Image), profile, realtime_report_);
+        rt::apply_to_memory(meta_shm_.get(), sizeof(img::MetadataSlot), profile, realtime_report_);
+        rt::apply_to_memory(pre_allocated_.get(), sizeof(Image), profile, realtime_report_);
+        realtime_profile_ = profile;
+        realtime_pending_.store(true, std::memory_order_release);
+        return realtime_report_;
+    }
+
+    // Telemetry: which settings took effect; thread settings show up after the next load()
+    rt::RealtimeReport realtime_report() const
+    {
+        std::lock_guard lock(realtime_mutex_);
+        return realtime_report_;
+    }
+
+    void store(Image const &image, std::span<std::byte const> user_metadata = {})
+    {
+        // Publishing under the same lock keeps concurrent stores from pairing one frame's pixels
+        // with another frame's metadata
         sem_.wait();
-        *static_cast<Image *>(shm_.get()) = image;
+        auto const analysis = img::copy_and_analyze(get_shm(), image, analysis_);
+        get_meta()->publish(image.timestamp, image.frame_number, user_metadata, analysis);
         sem_.post();
     }
 
+    // Metadata of the last stored frame, without touching the payload
+    img::FrameMetadata peek() const noexcept
+    {
+        return get_meta()->peek();
+    }
+
+    // Loads only when a frame newer than last_seen (a FrameMetadata::sequence) was stored
+    std::optional<ReturnImage> load_if_newer(uint64_t last_seen)
+    {
+        if (get_meta()->sequence() <= last_seen)
+        {
+            return std::nullopt;
+        }
+        return load();
+    }
+
     ReturnImage load()
     {
         swapper_->stage(get_shm());
@@ -83,5 +147,20 @@ struct DoubleBufferShem
         assert(ret_ptr && "shared memory data is null");
         return ret_ptr;
     }
+
+    void apply_realtime_to_runner()
+    {
+        std::lock_guard lock(realtime_mutex_);
+        auto const thread_report = rt::apply_to_current_thread(realtime_profile_);
+        realtime_report_.affinity = thread_report.affinity;
+        realtime_report_.scheduling = thread_report.scheduling;
+    }
+
+    img::MetadataSlot *get_meta() const noexcept
+    {
+        auto ret_ptr = static_cast<img::MetadataSlot *>(meta_shm_.get());
+        assert(ret_ptr && "shared memory metadata is null");
+        return ret_ptr;
+    }
 };
 
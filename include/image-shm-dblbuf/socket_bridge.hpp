@@ -0,0 +1,434 @@
+#pragma once
+#include "image-shm-dblbuf/fd.hpp" // posix::Fd, posix::abstract_address, posix::throw_errno
+#include <algorithm>               // std::min, std::max
+#include <arpa/inet.h>             // inet_pton
+#include <chrono>                  // std::chrono
+#include <cstdint>                 // std::uint64_t
+#include <exception>               // std::exception_ptr
+#include <linux/errqueue.h>        // sock_extended_err
+#include <memory>                  // std::unique_ptr
+#include <netinet/in.h>            // sockaddr_in
+#include <netinet/tcp.h>           // TCP_NODELAY
+#include <poll.h>                  // poll
+#include <type_traits>             // std::is_trivially_copyable_v
+
+// Streams flat values (typically frames) from a shared memory channel to consumers that cannot
+// map the segment, over TCP or Unix stream sockets. The payload is sent straight from the slot
+// with a single sendmsg; on TCP, MSG_ZEROCOPY lets the NIC read the slot without a kernel copy.
+namespace bridge
+{
+    using posix::Fd;
+
+    [[noreturn]] inline void throw_errno(std::string_view what)
+    {
+        posix::throw_errno("bridge", what);
+    }
+
+    struct FrameHeader
+    {
+        static constexpr std::uint32_t MAGIC = 0x46524d42; // "BMRF"
+
+        std::uint32_t magic;
+        std::uint32_t reserved;
+        std::uint64_t payload_size;
+        std::uint64_t sequence;
+        std::uint64_t send_time_ns; // CLOCK_REALTIME, latency is only meaningful with synchronized clocks
+    };
+
+    struct Stats
+    {
+        std::uint64_t frames = 0;
+        std::uint64_t bytes = 0;
+        std::uint64_t zerocopy_fallbacks = 0; // sends the kernel completed by copying anyway
+        std::uint64_t latency_min_ns = UINT64_MAX;
+        std::uint64_t latency_max_ns = 0;
+        std::uint64_t latency_sum_ns = 0;
+        std::chrono::steady_clock::time_point first;
+        std::chrono::steady_clock::time_point last;
+
+        inline double throughput_mbps() const noexcept
+        {
+            auto const seconds = std::chrono::duration<double>(last - first).count();
+            return seconds > 0.0 ? static_cast<double>(bytes) * 8.0 / seconds / 1e6 : 0.0;
+        }
+
+        inline double latency_mean_us() const noexcept
+        {
+            return frames ? static_cast<double>(latency_sum_ns) / static_cast<double>(frames) / 1e3 : 0.0;
+        }
+
+        inline void record(std::uint64_t size, std::uint64_t latency_ns) noexcept
+        {
+            auto const now = std::chrono::steady_clock::now();
+            if (frames == 0)
+            {
+                first = now;
+            }
+            last = now;
+            ++frames;
+            bytes += size;
+            latency_min_ns = std::min(latency_min_ns, latency_ns);
+            latency_max_ns = std::max(latency_max_ns, latency_ns);
+            latency_sum_ns += latency_ns;
+        }
+    };
+
+    inline std::uint64_t realtime_ns() noexcept
+    {
+        return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                              std::chrono::system_clock::now().time_since_epoch())
+                                              .count());
+    }
+
+    // -------------------------------------------------------------------------------------------
+    // Socket setup
+
+    inline Fd listen_tcp(std::uint16_t port, std::string const &address = "127.0.0.1")
+    {
+        auto socket = Fd(::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0));
+        if (socket.get() < 0)
+        {
+            throw_errno("socket");
+        }
+        int const one = 1;
+        ::setsockopt(socket.get(), SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        if (::inet_pton(AF_INET, address.c_str(), &addr.sin_addr) != 1)
+        {
+            throw std::runtime_error(fmt::format("bridge: invalid address '{}'", address));
+        }
+        if (::bind(socket.get(), reinterpret_cast<sockaddr const *>(&addr), sizeof(addr)) != 0)
+        {
+            throw_errno(fmt::format("bind {}:{}", address, port));
+        }
+        if (::listen(socket.get(), 1) != 0)
+        {
+            throw_errno("listen");
+        }
+        return socket;
+    }
+
+    // Port actually bound, useful after listen_tcp(0)
+    inline std::uint16_t local_port(Fd const &socket)
+    {
+        sockaddr_in addr{};
+        socklen_t length = sizeof(addr);
+        if (::getsockname(socket.get(), reinterpret_cast<sockaddr *>(&addr), &length) != 0)
+        {
+            throw_errno("getsockname");
+        }
+        return ntohs(addr.sin_port);
+    }
+
+    inline Fd connect_tcp(std::string const &address, std::uint16_t port)
+    {
+        auto socket = Fd(::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0));
+        if (socket.get() < 0)
+        {
+            throw_errno("socket");
+        }
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        if (::inet_pton(AF_INET, address.c_str(), &addr.sin_addr) != 1)
+        {
+            throw std::runtime_error(fmt::format("bridge: invalid address '{}'", address));
+        }
+        if (::connect(socket.get(), reinterpret_cast<sockaddr const *>(&addr), sizeof(addr)) != 0)
+        {
+            throw_errno(fmt::format("connect {}:{}", address, port));
+        }
+        int const one = 1;
+        ::setsockopt(socket.get(), IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        return socket;
+    }
+
+    inline Fd listen_unix(std::string const &name)
+    {
+        auto socket = Fd(::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0));
+        if (socket.get() < 0)
+        {
+            throw_errno("socket");
+        }
+        auto const [addr, length] = posix::abstract_address("bridge", name);
+        if (::bind(socket.get(), reinterpret_cast<sockaddr const *>(&addr), length) != 0)
+        {
+            throw_errno(fmt::format("bind '{}'", name));
+        }
+        if (::listen(socket.get(), 1) != 0)
+        {
+            throw_errno("listen");
+        }
+        return socket;
+    }
+
+    inline Fd connect_unix(std::string const &name)
+    {
+        auto socket = Fd(::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0));
+        if (socket.get() < 0)
+        {
+            throw_errno("socket");
+        }
+        auto const [addr, length] = posix::abstract_address("bridge", name);
+        if (::connect(socket.get(), reinterpret_cast<sockaddr const *>(&addr), length) != 0)
+        {
+            throw_errno(fmt::format("connect '{}'", name));
+        }
+        return socket;
+    }
+
+    inline Fd accept(Fd const &listener)
+    {
+        auto socket = Fd(::accept4(listener.get(), nullptr, nullptr, SOCK_CLOEXEC));
+        if (socket.get() < 0)
+        {
+            throw_errno("accept");
+        }
+        int const one = 1;
+        ::setsockopt(socket.get(), IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)); // fails harmlessly on AF_UNIX
+        return socket;
+    }
+
+    // -------------------------------------------------------------------------------------------
+
+    template <typename T>
+    struct Sender
+    {
+        static_assert(std::is_trivially_copyable_v<T>, "Sender requires a flat type");
+
+        // zerocopy requests MSG_ZEROCOPY; it silently stays off on sockets that do not support it (AF_UNIX)
+        explicit Sender(Fd socket, bool zerocopy = true)
+            : socket_(std::move(socket))
+        {
+            int const one = 1;
+            zerocopy_ = zerocopy && ::setsockopt(socket_.get(), SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) == 0;
+        }
+
+        // Sends header and payload straight from value; returns once the kernel no longer references value
+        void send(T const &value)
+        {
+            auto const start = std::chrono::steady_clock::now();
+            FrameHeader header{FrameHeader::MAGIC, 0, sizeof(T), sequence_++, realtime_ns()};
+            iovec iov[2] = {{&header, sizeof(header)},
+                            {const_cast<T *>(&value), sizeof(T)}};
+            send_all(iov, 2);
+            if (zerocopy_)
+            {
+                wait_completions();
+            }
+            stats_.record(sizeof(T), static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                                                   std::chrono::steady_clock::now() - start)
+                                                                   .count()));
+        }
+
+        // Consumes one value from a channel (FlatShmProducerConsumer-like API) and sends it from the slot
+        template <typename CHANNEL>
+        void forward(CHANNEL &channel)
+        {
+            std::exception_ptr error;
+            channel.consume([&](T const &value)
+                            {
+                                try
+                                {
+                                    send(value);
+                                }
+                                catch (...)
+                                {
+                                    error = std::current_exception();
+                                } });
+            if (error)
+            {
+                std::rethrow_exception(error);
+            }
+        }
+
+        inline bool zerocopy() const noexcept
+        {
+            return zerocopy_;
+        }
+
+        // Latency here is the time send() held the value, including zerocopy completion
+        inline Stats const &stats() const noexcept
+        {
+            return stats_;
+        }
+
+    private:
+        Fd socket_;
+        bool zerocopy_ = false;
+        std::uint64_t sequence_ = 0;
+        std::uint32_t zerocopy_issued_ = 0;
+        std::uint32_t zerocopy_completed_ = 0;
+        Stats stats_;
+
+        void send_all(iovec *iov, std::size_t count)
+        {
+            while (count)
+            {
+                msghdr msg{};
+                msg.msg_iov = iov;
+                msg.msg_iovlen = count;
+                auto const sent = ::sendmsg(socket_.get(), &msg, MSG_NOSIGNAL | (zerocopy_ ? MSG_ZEROCOPY : 0));
+                if (sent < 0)
+                {
+                    if (errno == EINTR)
+                    {
+                        continue;
+                    }
+                    throw_errno("sendmsg");
+                }
+                if (zerocopy_)
+                {
+                    ++zerocopy_issued_;
+                }
+                auto remaining = static_cast<std::size_t>(sent);
+                while (count && remaining >= iov->iov_len)
+                {
+                    remaining -= iov->iov_len;
+                    ++iov;
+                    --count;
+                }
+                if (count)
+                {
+                    iov->iov_base = static_cast<char *>(iov->iov_base) + remaining;
+                    iov->iov_len -= remaining;
+                }
+            }
+        }
+
+        // Drains MSG_ZEROCOPY notifications until every issued sendmsg has released its pages
+        void wait_completions()
+        {
+            while (zerocopy_completed_ != zerocopy_issued_)
+            {
+                pollfd pfd{socket_.get(), 0, 0};
+                if (::poll(&pfd, 1, -1) < 0 && errno != EINTR)
+                {
+                    throw_errno("poll");
+                }
+                alignas(cmsghdr) char control[CMSG_SPACE(sizeof(sock_extended_err) + sizeof(sockaddr_in))]{};
+                msghdr msg{};
+                msg.msg_control = control;
+                msg.msg_controllen = sizeof(control);
+                if (::recvmsg(socket_.get(), &msg, MSG_ERRQUEUE) < 0)
+                {
+                    if (errno == EAGAIN || errno == EINTR)
+                    {
+                        continue;
+                    }
+                    throw_errno("recvmsg(MSG_ERRQUEUE)");
+                }
+                for (auto *cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg))
+                {
+                    sock_extended_err err{};
+                    std::memcpy(&err, CMSG_DATA(cmsg), sizeof(err));
+                    if (err.ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+                    {
+                        continue;
+                    }
+                    zerocopy_completed_ += err.ee_data - err.ee_info + 1;
+                    if (err.ee_code & SO_EE_CODE_ZEROCOPY_COPIED)
+                    {
+                        ++stats_.zerocopy_fallbacks;
+                    }
+                }
+            }
+        }
+    };
+
+    template <typename T>
+    struct Receiver
+    {
+        static_assert(std::is_trivially_copyable_v<T>, "Receiver requires a flat type");
+
+        explicit Receiver(Fd socket)
+            : socket_(std::move(socket))
+        {
+        }
+
+        // Receives the next value directly into out; returns false when the sender closed the stream
+        bool receive(T &out)
+        {
+            FrameHeader header{};
+            if (!receive_all(&header, sizeof(header), true))
+            {
+                return false;
+            }
+            if (header.magic != FrameHeader::MAGIC || header.payload_size != sizeof(T))
+            {
+                throw std::runtime_error(fmt::format("bridge: unexpected frame header (magic {:#x}, payload {} bytes, expected {})",
+                                                     header.magic, header.payload_size, sizeof(T)));
+            }
+            receive_all(&out, sizeof(T), false);
+            last_sequence_ = header.sequence;
+            auto const now = realtime_ns();
+            stats_.record(sizeof(T), now > header.send_time_ns ? now - header.send_time_ns : 0);
+            return true;
+        }
+
+        // Receives the next value and publishes it to a local channel with the same produce() API
+        template <typename CHANNEL>
+        bool republish(CHANNEL &channel)
+        {
+            if (!staging_)
+            {
+                staging_ = std::make_unique_for_overwrite<T>();
+            }
+            if (!receive(*staging_))
+            {
+                return false;
+            }
+            channel.produce(*staging_);
+            return true;
+        }
+
+        inline std::uint64_t last_sequence() const noexcept
+        {
+            return last_sequence_;
+        }
+
+        // Latency here is sender wall clock to fully received payload
+        inline Stats const &stats() const noexcept
+        {
+            return stats_;
+        }
+
+    private:
+        Fd socket_;
+        std::unique_ptr<T> staging_;
+        std::uint64_t last_sequence_ = 0;
+        Stats stats_;
+
+        // Fills data completely; end of stream is a clean close only at a frame boundary, before
+        // the first byte, and throws anywhere else
+        bool receive_all(void *data, std::size_t size, bool frame_boundary)
+        {
+            auto *ptr = static_cast<char *>(data);
+            while (size)
+            {
+                auto const received = ::recv(socket_.get(), ptr, size, MSG_WAITALL);
+                if (received == 0)
+                {
+                    if (frame_boundary && ptr == data)
+                    {
+                        return false;
+                    }
+                    throw std::runtime_error("bridge: stream closed in the middle of a frame");
+                }
+                if (received < 0)
+                {
+                    if (errno == EINTR)
+                    {
+                        continue;
+                    }
+                    throw_errno("recv");
+                }
+                ptr += received;
+                size -= static_cast<std::size_t>(received);
+            }
+            return true;
+        }
+    };
+} // namespace bridge
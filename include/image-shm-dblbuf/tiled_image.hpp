@@ -0,0 +1,233 @@
+#pragma once
+#include "image-shm-dblbuf/image.hpp"
+#include <algorithm> // std::min
+#include <condition_variable> // std::condition_variable_any
+#include <cstdint>   // std::uint64_t
+#include <cstring>   // std::memcpy
+#include <mutex>     // std::mutex, std::unique_lock
+#include <span>      // std::span
+#include <thread>    // std::jthread
+#include <type_traits> // std::remove_reference_t
+#include <utility>   // std::pair
+#include <vector>    // std::vector
+
+namespace img
+{
+    // Frame stored as a grid of TILE x TILE tiles, each contiguous and cache-line aligned.
+    // Edge tiles are padded to the full tile size so every tile has the same shape.
+    template <std::size_t WIDTH, std::size_t HEIGHT, ImageType TYPE, std::size_t TILE>
+    struct TiledImage
+    {
+        static_assert(TYPE != ImageType::NV12, "Tiled layout requires an interleaved RGB / RGBA image");
+
+        static std::size_t const width = WIDTH;
+        static std::size_t const height = HEIGHT;
+        static ImageType const type = TYPE;
+        static constexpr std::size_t channels = static_cast<std::size_t>(img::channels(TYPE));
+        static constexpr std::size_t tile_size = TILE;
+        static constexpr std::size_t tiles_x = (WIDTH + TILE - 1) / TILE;
+        static constexpr std::size_t tiles_y = (HEIGHT + TILE - 1) / TILE;
+        static constexpr std::size_t tile_count = tiles_x * tiles_y;
+        static constexpr std::size_t tile_row_bytes = TILE * channels;
+        static constexpr std::size_t tile_bytes = TILE * tile_row_bytes;
+        static constexpr std::size_t size = tile_count * tile_bytes;
+
+        static_assert(tile_bytes % 64 == 0, "Tiles must be a whole number of cache lines");
+
+        uint64_t timestamp;
+        uint64_t frame_number;
+        alignas(64) std::array<std::uint8_t, size> data;
+
+        inline std::span<std::uint8_t, tile_bytes> tile(std::size_t tx, std::size_t ty) noexcept
+        {
+            return std::span<std::uint8_t, tile_bytes>(data.data() + (ty * tiles_x + tx) * tile_bytes, tile_bytes);
+        }
+
+        inline std::span<std::uint8_t const, tile_bytes> tile(std::size_t tx, std::size_t ty) const noexcept
+        {
+            return std::span<std::uint8_t const, tile_bytes>(data.data() + (ty * tiles_x + tx) * tile_bytes, tile_bytes);
+        }
+
+        // Tile index for a linear tile number, row-major over the tile grid
+        static constexpr std::pair<std::size_t, std::size_t> tile_coords(std::size_t index) noexcept
+        {
+            return {index % tiles_x, index / tiles_x};
+        }
+    };
+
+    template <typename TILED>
+    using LinearImageOf = Image<TILED::width, TILED::height, TILED::type>;
+
+    // Typedefs for common tiled image types
+    using TiledImage4K_RGB_64 = TiledImage<3840, 2160, ImageType::RGB, 64>;
+    using TiledImage4K_RGB_128 = TiledImage<3840, 2160, ImageType::RGB, 128>;
+    using TiledImageFHD_RGB_64 = TiledImage<1920, 1080, ImageType::RGB, 64>;
+
+    // Worker threads started once and reused for every tile job; the calling thread takes the
+    // first share. One job runs at a time, so a pool must not be shared by concurrent callers.
+    struct TilePool
+    {
+        explicit TilePool(std::size_t threads)
+        {
+            threads = std::max<std::size_t>(threads, 1);
+            workers_.reserve(threads - 1);
+            for (std::size_t t = 1; t < threads; ++t)
+            {
+                workers_.emplace_back([this, t](std::stop_token stop)
+                                      { work(stop, t); });
+            }
+        }
+
+        // Workers hold a pointer to the pool
+        TilePool(TilePool const &) = delete;
+        TilePool &operator=(TilePool const &) = delete;
+
+        inline std::size_t threads() const noexcept
+        {
+            return workers_.size() + 1;
+        }
+
+        // Runs share(t) for every t < shares, share(0) on the calling thread; shares is clamped to threads()
+        template <typename SHARE>
+        void run(std::size_t shares, SHARE &&share)
+        {
+            shares = std::min(shares, threads());
+            if (shares <= 1)
+            {
+                if (shares == 1)
+                {
+                    share(0);
+                }
+                return;
+            }
+            {
+                std::lock_guard lock(job_mutex_);
+                job_ = &invoke<std::remove_reference_t<SHARE>>;
+                job_context_ = &share;
+                job_shares_ = shares;
+                job_pending_ = shares - 1;
+                ++job_generation_;
+            }
+            job_ready_.notify_all();
+            share(0);
+            std::unique_lock lock(job_mutex_);
+            job_done_.wait(lock, [this]
+                           { return job_pending_ == 0; });
+        }
+
+    private:
+        // Current run() job, published to the workers under job_mutex_
+        std::mutex job_mutex_;
+        std::condition_variable_any job_ready_;
+        std::condition_variable_any job_done_;
+        std::uint64_t job_generation_ = 0;
+        std::size_t job_pending_ = 0;
+        std::size_t job_shares_ = 0;
+        void (*job_)(void *, std::size_t) = nullptr;
+        void *job_context_ = nullptr;
+        std::vector<std::jthread> workers_; // last, so the workers stop before the state they use goes away
+
+        template <typename SHARE>
+        static void invoke(void *context, std::size_t t)
+        {
+            (*static_cast<SHARE *>(context))(t);
+        }
+
+        void work(std::stop_token stop, std::size_t t)
+        {
+            std::uint64_t seen = 0;
+            while (true)
+            {
+                {
+                    std::unique_lock lock(job_mutex_);
+                    if (!job_ready_.wait(lock, stop, [this, seen]
+                                         { return job_generation_ != seen; }))
+                    {
+                        return;
+                    }
+                    seen = job_generation_;
+                    if (t >= job_shares_)
+                    {
+                        continue;
+                    }
+                }
+                job_(job_context_, t);
+                {
+                    std::lock_guard lock(job_mutex_);
+                    --job_pending_;
+                }
+                job_done_.notify_one();
+            }
+        }
+    };
+
+    // Runs fn(tx, ty) for every tile, split in contiguous tile ranges across the pool's threads,
+    // or on the calling thread alone without a pool
+    template <typename TILED, typename FUNC>
+    void for_each_tile(FUNC &&fn, TilePool *pool = nullptr)
+    {
+        auto const threads = std::clamp<std::size_t>(pool ? pool->threads() : 1, 1, TILED::tile_count);
+        auto const per_thread = (TILED::tile_count + threads - 1) / threads;
+        auto run = [&fn, per_thread](std::size_t t)
+        {
+            auto const end = std::min((t + 1) * per_thread, TILED::tile_count);
+            for (auto index = t * per_thread; index < end; ++index)
+            {
+                auto const [tx, ty] = TILED::tile_coords(index);
+                fn(tx, ty);
+            }
+        };
+        if (!pool)
+        {
+            run(0);
+            return;
+        }
+        pool->run(threads, run);
+    }
+
+    // Linear -> tiled. Each tile row is one contiguous copy, padding is zeroed.
+    template <typename TILED>
+    void to_tiled(LinearImageOf<TILED> const &src, TILED &dst, TilePool *pool = nullptr)
+    {
+        constexpr auto src_stride = TILED::width * TILED::channels;
+        dst.timestamp = src.timestamp;
+        dst.frame_number = src.frame_number;
+        for_each_tile<TILED>([&](std::size_t tx, std::size_t ty)
+                             {
+                                 auto tile = dst.tile(tx, ty);
+                                 auto const x0 = tx * TILED::tile_size;
+                                 auto const y0 = ty * TILED::tile_size;
+                                 auto const row_bytes = (std::min(TILED::tile_size, TILED::width - x0)) * TILED::channels;
+                                 auto const rows = std::min(TILED::tile_size, TILED::height - y0);
+                                 for (std::size_t row = 0; row < rows; ++row)
+                                 {
+                                     auto *out = tile.data() + row * TILED::tile_row_bytes;
+                                     std::memcpy(out, src.data.data() + (y0 + row) * src_stride + x0 * TILED::channels, row_bytes);
+                                     std::memset(out + row_bytes, 0, TILED::tile_row_bytes - row_bytes);
+                                 }
+                                 std::memset(tile.data() + rows * TILED::tile_row_bytes, 0, (TILED::tile_size - rows) * TILED::tile_row_bytes); },
+                             pool);
+    }
+
+    // Tiled -> linear, padding is dropped
+    template <typename TILED>
+    void to_linear(TILED const &src, LinearImageOf<TILED> &dst, TilePool *pool = nullptr)
+    {
+        constexpr auto dst_stride = TILED::width * TILED::channels;
+        dst.timestamp = src.timestamp;
+        dst.frame_number = src.frame_number;
+        for_each_tile<TILED>([&](std::size_t tx, std::size_t ty)
+                             {
+                                 auto const tile = src.tile(tx, ty);
+                                 auto const x0 = tx * TILED::tile_size;
+                                 auto const y0 = ty * TILED::tile_size;
+                                 auto const row_bytes = (std::min(TILED::tile_size, TILED::width - x0)) * TILED::channels;
+                                 auto const rows = std::min(TILED::tile_size, TILED::height - y0);
+                                 for (std::size_t row = 0; row < rows; ++row)
+                                 {
+                                     std::memcpy(dst.data.data() + (y0 + row) * dst_stride + x0 * TILED::channels,
+                                                 tile.data() + row * TILED::tile_row_bytes, row_bytes);
+                                 } },
+                             pool);
+    }
+} // namespace img
@@ -1,43 +1,228 @@
+#include "image-shm-dblbuf/batch_builder.hpp"
+#include "image-shm-dblbuf/flat_shm_broadcaster.hpp"
+#include "image-shm-dblbuf/flat_shm_producer_consumer.hpp"
+#include "image-shm-dblbuf/frame_pool.hpp"
 #include "image-shm-dblbuf/shm.hpp"
+#include "image-shm-dblbuf/tiled_image.hpp"
 #include "nanobind/nanobind.h"
 #include "nanobind/ndarray.h"
+#include "nanobind/stl/array.h"
+#include "nanobind/stl/optional.h"
 #include "nanobind/stl/shared_ptr.h"
 #include "nanobind/stl/string.h"
+#include "nanobind/stl/vector.h"
 
 namespace nb = nanobind;
 using namespace nb::literals;
 
+// Expose img::Half as a DLPack float16 so batches can be handed to numpy / torch without copying
+namespace nanobind::detail
+{
+    template <>
+    struct dtype_traits<img::Half>
+    {
+        static constexpr dlpack::dtype value{static_cast<std::uint8_t>(dlpack::dtype_code::Float), 16, 1};
+        static constexpr auto name = const_name("float16");
+    };
+} // namespace nanobind::detail
+
+// Single producer: store() is not serialised against stores from other processes (within one
+// process the GIL serialises them), a second writer could pair pixels and metadata of different frames
 struct ProducerConsumer
 {
     shm::Shm shm_;
-    std::shared_ptr<img::Image4K_RGB> image_ = std::make_shared<img::Image4K_RGB>();
+    shm::Shm meta_shm_;
+    std::shared_ptr<img::Image4K_RGB> image_ = img::make_pooled_shared<img::Image4K_RGB>();
+    img::AnalysisOptions analysis_;
+    img::FrameAnalysis last_analysis_{};
 
      ProducerConsumer(std::string const &shm_name)
-         : shm_(shm_name, sizeof(img::Image4K_RGB))
+         : shm_(shm_name, sizeof(img::Image4K_RGB)),
+           meta_shm_(shm_name + "_meta", sizeof(img::MetadataSlot))
+     {
+     }
+
+     img::MetadataSlot &meta() noexcept
+     {
+          return *static_cast<img::MetadataSlot *>(meta_shm_.get());
+     }
+
+     img::Image4K_RGB *shared_image() noexcept
+     {
+          return static_cast<img::Image4K_RGB *>(shm_.get());
+     }
+
+     // The consumer's copy runs the same fused kernel, last_analysis_ lets it verify the publisher's CRC
+     std::shared_ptr<img::Image4K_RGB> load()
+     {
+          last_analysis_ = img::copy_and_analyze(image_.get(), *shared_image(), analysis_);
+          return image_;
+     }
+};
+
+std::span<std::byte const> as_user_metadata(nb::bytes const &user)
+{
+     return {static_cast<std::byte const *>(user.data()), user.size()};
+}
+
+struct Subscriber
+{
+    flat_shm::FlatShmSubscriber<img::Image4K_RGB> subscriber_;
+    std::shared_ptr<img::Image4K_RGB> image_ = img::make_pooled_shared<img::Image4K_RGB>();
+
+     Subscriber(std::string const &shm_name, flat_shm::SubscriptionFilter const &filter)
+         : subscriber_(shm_name, filter)
      {
      }
 };
 
+template <typename OUT>
+void bind_batch_builder(nb::module_ &m, char const *name)
+{
+     using Builder = img::BatchBuilder<img::Image4K_RGB, OUT>;
+
+     nb::class_<Builder>(m, name)
+         .def(nb::init<img::BatchConfig const &>())
+         .def("add", [](Builder &self, img::Image4K_RGB const &image)
+              { return self.add(image); }, nb::call_guard<nb::gil_scoped_release>())
+         .def("add_from", [](Builder &self, DoubleBufferShem &source)
+              {
+                 if (self.full())
+                 {
+                      throw std::runtime_error("BatchBuilder: batch is full");
+                 }
+                 source.sem_.wait();
+                 auto const index = self.add(*source.get_shm());
+                 source.sem_.post();
+                 return index; }, nb::call_guard<nb::gil_scoped_release>())
+         .def("add_from", [](Builder &self, ProducerConsumer &source)
+              { return self.add(*static_cast<img::Image4K_RGB const *>(source.shm_.get())); }, nb::call_guard<nb::gil_scoped_release>())
+         .def("reset", &Builder::reset)
+         .def("size", &Builder::size)
+         .def("full", &Builder::full)
+         .def("shape", &Builder::shape)
+         .def("timestamps", &Builder::timestamps)
+         .def("frame_numbers", &Builder::frame_numbers)
+         .def("tensor", [](Builder &self)
+              {
+                 auto const shape = self.shape();
+                 return nb::ndarray<OUT, nb::c_contig>(self.data(), shape.size(), shape.data(), nb::handle()); }, nb::rv_policy::reference_internal);
+}
+
+// numpy shape of an image: (height, width, channels), or (height * 3 / 2, width) for the NV12 planes
+template <typename IMAGE>
+std::vector<std::size_t> image_shape()
+{
+     if constexpr (IMAGE::type == img::ImageType::NV12)
+     {
+          return {IMAGE::height * 3 / 2, IMAGE::width};
+     }
+     else
+     {
+          return {IMAGE::height, IMAGE::width, static_cast<std::size_t>(img::channels(IMAGE::type))};
+     }
+}
+
+// Channel plus a pooled frame that load() copies into, so Python never sees the shared slot
+template <typename IMAGE, typename CHANNEL>
+struct ChannelEndpoint
+{
+    CHANNEL channel_;
+    std::shared_ptr<IMAGE> image_ = img::make_pooled_shared<IMAGE>();
+
+     ChannelEndpoint(std::string const &shm_name)
+         : channel_(shm_name)
+     {
+     }
+};
+
+template <typename IMAGE, typename CHANNEL>
+void bind_channel(nb::module_ &m, std::string const &name)
+{
+     using Endpoint = ChannelEndpoint<IMAGE, CHANNEL>;
+
+     nb::class_<Endpoint>(m, name.c_str())
+         .def(nb::init<std::string>())
+         .def("store", [](Endpoint &self, IMAGE const &image)
+              { self.channel_.produce(image); }, nb::call_guard<nb::gil_scoped_release>())
+         .def("load", [](Endpoint &self) -> std::shared_ptr<IMAGE>
+              {
+                 {
+                      nb::gil_scoped_release release;
+                      self.channel_.load(*self.image_);
+                 }
+                 return self.image_; }, nb::rv_policy::reference_internal)
+         .def("sequence", [](Endpoint &self)
+              { return self.channel_.sequence(); })
+         .def("last_seen", [](Endpoint const &self)
+              { return self.channel_.last_seen(); })
+         .def("apply_realtime", [](Endpoint &self, rt::RealtimeProfile const &profile)
+              {
+                 auto report = self.channel_.apply_realtime(profile);
+                 rt::apply_to_memory(self.image_.get(), sizeof(IMAGE), profile, report);
+                 return report; });
+}
+
+// Image class plus its latest-value and lossless channels, e.g. Image4K_RGB, LatestChannel4K_RGB
+// and HandshakeChannel4K_RGB for suffix "4K_RGB"
+template <typename IMAGE>
+void bind_image(nb::module_ &m, std::string const &suffix)
+{
+     nb::class_<IMAGE>(m, ("Image" + suffix).c_str())
+         .def(nb::new_([]
+                       { return img::make_pooled_shared<IMAGE>(); }))
+         .def_static("pool", []() -> img::FramePool &
+                     { return img::FramePool::of<IMAGE>(); }, nb::rv_policy::reference)
+         .def_rw("timestamp", &IMAGE::timestamp)
+         .def_rw("frame_number", &IMAGE::frame_number)
+         .def("shape", [](IMAGE const &)
+              { return image_shape<IMAGE>(); })
+
+         .def("get_data", [](IMAGE const &self)
+              {
+                 auto const shape = image_shape<IMAGE>();
+                 return nb::ndarray<uint8_t const, nb::numpy>(self.data.data(), shape.size(), shape.data(), nb::handle()); }, nb::rv_policy::reference_internal)
+
+         .def("set_data", [](IMAGE &self, nb::ndarray<uint8_t const, nb::c_contig> array)
+              {
+                 if (array.size() != IMAGE::size)
+                 {
+                      throw std::runtime_error(fmt::format("set_data: expected {} bytes, got {}", IMAGE::size, array.size()));
+                 }
+                 std::memcpy(self.data.data(), array.data(), array.size() * sizeof(uint8_t)); });
+
+     bind_channel<IMAGE, flat_shm::LatestValueChannel<IMAGE>>(m, "LatestChannel" + suffix);
+     bind_channel<IMAGE, flat_shm::FlatShmProducerConsumer<IMAGE>>(m, "HandshakeChannel" + suffix);
+}
+
 //--------------------------------------------------------------------------------------------
 
 NB_MODULE(image_shm_dblbuff, m)
 {
 
-     nb::class_<img::Image4K_RGB>(m, "Image4K_RGB")
+     nb::class_<img::FramePoolOptions>(m, "FramePoolOptions")
          .def(nb::init<>())
-         .def_rw("timestamp", &img::Image4K_RGB::timestamp)
-         .def_rw("frame_number", &img::Image4K_RGB::frame_number)
-         .def("shape", [](const img::Image4K_RGB &)
-              { return std::array<size_t, 3>{
-                    img::Image4K_RGB::height,
-                    img::Image4K_RGB::width,
-                    static_cast<size_t>(img::channels(img::Image4K_RGB::type))}; })
+         .def_rw("huge_pages", &img::FramePoolOptions::huge_pages)
+         .def_rw("prefault", &img::FramePoolOptions::prefault);
 
-         .def("get_data", [](const img::Image4K_RGB &self)
-              { return nb::ndarray<uint8_t const, nb::numpy, nb::shape<2160, 3840, 3>>((self.data.data())); }, nb::rv_policy::reference_internal)
+     nb::class_<img::FramePoolStats>(m, "FramePoolStats")
+         .def_ro("block_size", &img::FramePoolStats::block_size)
+         .def_ro("blocks", &img::FramePoolStats::blocks)
+         .def_ro("free", &img::FramePoolStats::free)
+         .def_ro("huge_pages", &img::FramePoolStats::huge_pages);
 
-         .def("set_data", [](img::Image4K_RGB &self, nb::ndarray<uint8_t const, nb::shape<img::Image4K_RGB::height, img::Image4K_RGB::width, static_cast<std::size_t>(img::channels(img::Image4K_RGB::type))>> array)
-              { std::memcpy(self.data.data(), array.data(), array.size() * sizeof(uint8_t)); });
+     nb::class_<img::FramePool>(m, "FramePool")
+         .def("configure", &img::FramePool::configure)
+         .def("reserve", &img::FramePool::reserve, nb::call_guard<nb::gil_scoped_release>())
+         .def("trim", &img::FramePool::trim)
+         .def("stats", &img::FramePool::stats);
+
+     bind_image<img::ImageFHD_RGB>(m, "FHD_RGB");
+     bind_image<img::ImageFHD_RGBA>(m, "FHD_RGBA");
+     bind_image<img::ImageFHD_NV12>(m, "FHD_NV12");
+     bind_image<img::Image4K_RGB>(m, "4K_RGB");
+     bind_image<img::Image4K_RGBA>(m, "4K_RGBA");
+     bind_image<img::Image4K_NV12>(m, "4K_NV12");
 
      nb::class_<ReturnImage>(m, "ReturnImage")
          .def(nb::init<>())
@@ -51,25 +236,180 @@ NB_MODULE(image_shm_dblbuff, m)
                                    (*self.img_ptr_)->timestamp,
                                    (*self.img_ptr_)->frame_number); });
 
+     nb::class_<img::AnalysisOptions>(m, "AnalysisOptions")
+         .def(nb::init<>())
+         .def_rw("crc32c", &img::AnalysisOptions::crc32c)
+         .def_rw("histogram", &img::AnalysisOptions::histogram)
+         .def_rw("stats", &img::AnalysisOptions::stats);
+
+     nb::class_<img::FrameAnalysis>(m, "FrameAnalysis")
+         .def_ro("computed", &img::FrameAnalysis::computed)
+         .def_ro("crc32c", &img::FrameAnalysis::crc32c)
+         .def_ro("luma_min", &img::FrameAnalysis::luma_min)
+         .def_ro("luma_max", &img::FrameAnalysis::luma_max)
+         .def_ro("luma_mean", &img::FrameAnalysis::luma_mean)
+         .def_ro("luma_histogram", &img::FrameAnalysis::luma_histogram);
+
+     nb::class_<img::FrameMetadata>(m, "FrameMetadata")
+         .def_ro("sequence", &img::FrameMetadata::sequence)
+         .def_ro("timestamp", &img::FrameMetadata::timestamp)
+         .def_ro("frame_number", &img::FrameMetadata::frame_number)
+         .def_ro("publish_time_ns", &img::FrameMetadata::publish_time_ns)
+         .def_prop_ro("user", [](img::FrameMetadata const &self)
+                      { return nb::bytes(reinterpret_cast<char const *>(self.user.data()), self.user_size); })
+         .def_ro("analysis", &img::FrameMetadata::analysis)
+         .def("__repr__", [](img::FrameMetadata const &self) -> std::string
+              { return fmt::format("FrameMetadata(sequence = {}, timestamp = {}, frame_number = {}, user = {} bytes)",
+                                   self.sequence, self.timestamp, self.frame_number, self.user_size); });
+
      nb::class_<ProducerConsumer>(m, "ProducerConsumer")
          .def(nb::init<std::string>(), nb::rv_policy::reference_internal)
-         .def("store", [](ProducerConsumer &self, img::Image4K_RGB const &image)
-              { *static_cast<img::Image4K_RGB *>(self.shm_.get()) = image; })
-         .def("load", [](ProducerConsumer &self) -> std::shared_ptr<img::Image4K_RGB>
+         .def("store", [](ProducerConsumer &self, img::Image4K_RGB const &image, nb::bytes const &user)
               {
-                 *self.image_.get() = *static_cast<img::Image4K_RGB *>(self.shm_.get());
-                 return self.image_; }, nb::rv_policy::reference_internal);
+                 auto const analysis = img::copy_and_analyze(self.shared_image(), image, self.analysis_);
+                 self.meta().publish(image.timestamp, image.frame_number, as_user_metadata(user), analysis); }, "image"_a, "user"_a = nb::bytes("", 0))
+         .def("load", &ProducerConsumer::load, nb::rv_policy::reference_internal)
+         .def("set_analysis", [](ProducerConsumer &self, img::AnalysisOptions const &options)
+              { self.analysis_ = options; })
+         .def("last_analysis", [](ProducerConsumer const &self)
+              { return self.last_analysis_; })
+         .def("peek", [](ProducerConsumer &self)
+              { return self.meta().peek(); })
+         .def("load_if_newer", [](ProducerConsumer &self, uint64_t last_seen) -> std::optional<std::shared_ptr<img::Image4K_RGB>>
+              {
+                 if (self.meta().sequence() <= last_seen)
+                 {
+                      return std::nullopt;
+                 }
+                 return self.load(); }, nb::rv_policy::reference_internal);
+
+     nb::enum_<rt::SchedulingPolicy>(m, "SchedulingPolicy")
+         .value("OTHER", rt::SchedulingPolicy::OTHER)
+         .value("FIFO", rt::SchedulingPolicy::FIFO)
+         .value("DEADLINE", rt::SchedulingPolicy::DEADLINE);
+
+     nb::class_<rt::RealtimeProfile>(m, "RealtimeProfile")
+         .def(nb::init<>())
+         .def_rw("cpus", &rt::RealtimeProfile::cpus)
+         .def_rw("policy", &rt::RealtimeProfile::policy)
+         .def_rw("priority", &rt::RealtimeProfile::priority)
+         .def_rw("runtime_ns", &rt::RealtimeProfile::runtime_ns)
+         .def_rw("deadline_ns", &rt::RealtimeProfile::deadline_ns)
+         .def_rw("period_ns", &rt::RealtimeProfile::period_ns)
+         .def_rw("lock_memory", &rt::RealtimeProfile::lock_memory)
+         .def_rw("prefault", &rt::RealtimeProfile::prefault);
+
+     nb::class_<rt::SettingStatus>(m, "SettingStatus")
+         .def_ro("requested", &rt::SettingStatus::requested)
+         .def_ro("applied", &rt::SettingStatus::applied)
+         .def_ro("error", &rt::SettingStatus::error)
+         .def("__repr__", &rt::SettingStatus::to_string);
+
+     nb::class_<rt::RealtimeReport>(m, "RealtimeReport")
+         .def_ro("affinity", &rt::RealtimeReport::affinity)
+         .def_ro("scheduling", &rt::RealtimeReport::scheduling)
+         .def_ro("memory_lock", &rt::RealtimeReport::memory_lock)
+         .def_ro("prefault", &rt::RealtimeReport::prefault)
+         .def("__repr__", &rt::RealtimeReport::summary);
+
+     // For threads created from Python, e.g. a consumer loop
+     m.def("apply_realtime_to_current_thread", &rt::apply_to_current_thread);
 
      nb::class_<DoubleBufferShem>(m, "DoubleBufferShem")
          .def(nb::init<std::string>(), nb::rv_policy::reference_internal)
-         .def("store", [](DoubleBufferShem &self, img::Image4K_RGB const &image)
-              { self.store(image); })
+         .def("store", [](DoubleBufferShem &self, img::Image4K_RGB const &image, nb::bytes const &user)
+              { self.store(image, as_user_metadata(user)); }, "image"_a, "user"_a = nb::bytes("", 0))
 
          .def("load", [](DoubleBufferShem &self) -> ReturnImage
               { return self.load(); }, nb::rv_policy::reference_internal)
+         .def("set_analysis", &DoubleBufferShem::set_analysis)
+         .def("apply_realtime", &DoubleBufferShem::apply_realtime)
+         .def("realtime_report", &DoubleBufferShem::realtime_report)
+         .def("peek", &DoubleBufferShem::peek)
+         .def("load_if_newer", &DoubleBufferShem::load_if_newer, nb::rv_policy::reference_internal)
          .def("__repr__", [](DoubleBufferShem const &self) -> std::string
               { return fmt::format("DoubleBufferShem(shm = {:p}, img_ptr = {:p}, img = {:p})",
                                    self.shm_.get(),
                                    static_cast<const void *>(self.img_ptr_),
                                    static_cast<const void *>(self.pre_allocated_.get())); });
+
+     nb::enum_<img::TensorLayout>(m, "TensorLayout")
+         .value("NCHW", img::TensorLayout::NCHW)
+         .value("NHWC", img::TensorLayout::NHWC);
+
+     nb::class_<img::BatchConfig>(m, "BatchConfig")
+         .def(nb::init<>())
+         .def_rw("batch_size", &img::BatchConfig::batch_size)
+         .def_rw("width", &img::BatchConfig::width)
+         .def_rw("height", &img::BatchConfig::height)
+         .def_rw("layout", &img::BatchConfig::layout)
+         .def_rw("mean", &img::BatchConfig::mean)
+         .def_rw("std", &img::BatchConfig::std)
+         .def_rw("channel_order", &img::BatchConfig::channel_order)
+         .def_rw("threads", &img::BatchConfig::threads);
+
+     bind_batch_builder<float>(m, "BatchBuilder4K_RGB_F32");
+     bind_batch_builder<img::Half>(m, "BatchBuilder4K_RGB_F16");
+
+     nb::class_<flat_shm::SubscriptionFilter>(m, "SubscriptionFilter")
+         .def(nb::init<>())
+         .def_rw("every_nth", &flat_shm::SubscriptionFilter::every_nth)
+         .def_rw("min_period_ns", &flat_shm::SubscriptionFilter::min_period_ns)
+         .def_static("every", &flat_shm::SubscriptionFilter::every)
+         .def_static("rate", &flat_shm::SubscriptionFilter::rate);
+
+     nb::class_<flat_shm::FlatShmBroadcaster<img::Image4K_RGB>>(m, "Broadcaster")
+         .def(nb::init<std::string>())
+         .def("store", [](flat_shm::FlatShmBroadcaster<img::Image4K_RGB> &self, img::Image4K_RGB const &image)
+              { self.produce(image); }, nb::call_guard<nb::gil_scoped_release>())
+         .def("sequence", &flat_shm::FlatShmBroadcaster<img::Image4K_RGB>::sequence)
+         .def("apply_realtime", &flat_shm::FlatShmBroadcaster<img::Image4K_RGB>::apply_realtime);
+
+     nb::class_<Subscriber>(m, "Subscriber")
+         .def(nb::init<std::string, flat_shm::SubscriptionFilter>())
+         .def("load", [](Subscriber &self) -> std::shared_ptr<img::Image4K_RGB>
+              {
+                 {
+                      nb::gil_scoped_release release;
+                      self.subscriber_.load(*self.image_);
+                 }
+                 return self.image_; }, nb::rv_policy::reference_internal)
+         .def("delivered_sequence", [](Subscriber &self)
+              { return self.subscriber_.delivered_sequence(); })
+         .def("apply_realtime", [](Subscriber &self, rt::RealtimeProfile const &profile)
+              {
+                 auto report = self.subscriber_.apply_realtime(profile);
+                 rt::apply_to_memory(self.image_.get(), sizeof(img::Image4K_RGB), profile, report);
+                 return report; });
+
+     nb::class_<img::TilePool>(m, "TilePool")
+         .def(nb::init<std::size_t>(), "threads"_a)
+         .def("threads", &img::TilePool::threads);
+
+     using Tiled = img::TiledImage4K_RGB_64;
+     nb::class_<Tiled>(m, "TiledImage4K_RGB_64")
+         .def(nb::new_([]
+                       { return img::make_pooled_shared<Tiled>(); }))
+         .def_rw("timestamp", &Tiled::timestamp)
+         .def_rw("frame_number", &Tiled::frame_number)
+         .def_ro_static("tiles_x", &Tiled::tiles_x)
+         .def_ro_static("tiles_y", &Tiled::tiles_y)
+         .def_ro_static("tile_size", &Tiled::tile_size)
+         .def("tile", [](Tiled &self, std::size_t tx, std::size_t ty)
+              {
+                 if (tx >= Tiled::tiles_x || ty >= Tiled::tiles_y)
+                 {
+                      throw nb::index_error("tile index out of range");
+                 }
+                 return nb::ndarray<uint8_t, nb::numpy, nb::shape<Tiled::tile_size, Tiled::tile_size, Tiled::channels>>(self.tile(tx, ty).data()); }, nb::rv_policy::reference_internal)
+         .def("from_image", [](Tiled &self, img::Image4K_RGB const &image, img::TilePool *pool)
+              { img::to_tiled(image, self, pool); }, "image"_a, "pool"_a.none() = nb::none(), nb::call_guard<nb::gil_scoped_release>())
+         .def("to_image", [](Tiled const &self, img::TilePool *pool)
+              {
+                 auto image = img::make_pooled_shared<img::Image4K_RGB>();
+                 {
+                      nb::gil_scoped_release release;
+                      img::to_linear(self, *image, pool);
+                 }
+                 return image; }, "pool"_a.none() = nb::none());
 }
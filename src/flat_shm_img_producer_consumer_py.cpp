@@ -1,6 +1,6 @@
+#include "image-shm-dblbuf/channel.hpp"
+#include "image-shm-dblbuf/frame_pool.hpp"
 #include "image-shm-dblbuf/image.hpp"
-#include "shm/semaphore.hpp"
-#include "shm/shm.hpp"
 #include <cstring> // For std::memcpy
 #include <pybind11/functional.h>
 #include <pybind11/numpy.h>
@@ -8,35 +8,28 @@
 #include <pybind11/stl.h>
 namespace py = pybind11;
 
-struct ProducerConsumer
-{
-    shm::Shm shm_;
-    shm::Semaphore sem_read_;
-    shm::Semaphore sem_write_;
-    std::shared_ptr<img::Image4K_RGB> image_ = std::make_shared<img::Image4K_RGB>();
-
-    ProducerConsumer(std::string const &shm_name)
-        : shm_(shm_name, sizeof(img::Image4K_RGB)),
-          sem_read_(shm_name + "_read_sem", 0),
-          sem_write_(shm_name + "_write_sem", 1)
-    {
-    }
-};
-
-//--------------------------------------------------------------------------------------------
 using Image = img::Image4K_RGB;
 
-struct AtomicProducerConsumer
+// A shared value channel plus the pooled frame load() copies into
+template <typename CHANNEL>
+struct SharedValueEndpoint
 {
-    shm::Shm shm_;
-    std::shared_ptr<img::Image4K_RGB> image_ = std::make_shared<Image>();
+    CHANNEL channel_;
+    std::shared_ptr<Image> image_ = img::make_pooled_shared<Image>();
 
-    AtomicProducerConsumer(std::string const &shm_name)
-        : shm_(shm_name, sizeof(Image))
+    SharedValueEndpoint(std::string const &shm_name)
+        : channel_(shm_name)
     {
     }
 };
 
+// Not called ProducerConsumer: the nanobind module's ProducerConsumer keeps a raw image plus a
+// _meta segment, and the two layouts must never be attached to the same name
+using SharedValueProducerConsumer = SharedValueEndpoint<flat_shm::SharedValueChannel<Image>>;
+
+//--------------------------------------------------------------------------------------------
+using AtomicProducerConsumer = SharedValueEndpoint<flat_shm::SharedValueChannel<Image, flat_shm::copy::Memcpy>>;
+
 // Create the Pybind11 module
 PYBIND11_MODULE(Share_memory_image_producer_consumer, m)
 {
@@ -47,9 +40,30 @@ PYBIND11_MODULE(Share_memory_image_producer_consumer, m)
         .value("NV12", img::ImageType::NV12)
         .export_values();
 
+    // Expose the process-wide frame pool
+    py::class_<img::FramePoolOptions>(m, "FramePoolOptions")
+        .def(py::init<>())
+        .def_readwrite("huge_pages", &img::FramePoolOptions::huge_pages)
+        .def_readwrite("prefault", &img::FramePoolOptions::prefault);
+
+    py::class_<img::FramePoolStats>(m, "FramePoolStats")
+        .def_readonly("block_size", &img::FramePoolStats::block_size)
+        .def_readonly("blocks", &img::FramePoolStats::blocks)
+        .def_readonly("free", &img::FramePoolStats::free)
+        .def_readonly("huge_pages", &img::FramePoolStats::huge_pages);
+
+    py::class_<img::FramePool, std::unique_ptr<img::FramePool, py::nodelete>>(m, "FramePool")
+        .def("configure", &img::FramePool::configure)
+        .def("reserve", &img::FramePool::reserve, py::call_guard<py::gil_scoped_release>())
+        .def("trim", &img::FramePool::trim)
+        .def("stats", &img::FramePool::stats);
+
     // Expose Image4K_RGB
     py::class_<img::Image4K_RGB, std::shared_ptr<img::Image4K_RGB>>(m, "Image4K_RGB")
-        .def(py::init<>())                                              // default constructor
+        .def(py::init([]
+                      { return img::make_pooled_shared<img::Image4K_RGB>(); })) // recycled frame, pixels not zero filled
+        .def_static("pool", []() -> img::FramePool &
+                    { return img::FramePool::of<img::Image4K_RGB>(); }, py::return_value_policy::reference)
         .def_readwrite("timestamp", &img::Image4K_RGB::timestamp)       // expose timestamp
         .def_readwrite("frame_number", &img::Image4K_RGB::frame_number) // expose frame_number
         .def("get_data", [](const img::Image4K_RGB &self)
@@ -79,21 +93,21 @@ PYBIND11_MODULE(Share_memory_image_producer_consumer, m)
         }
         std::memcpy(self.data.data(), buf.ptr, buf.size * sizeof(uint8_t)); });
 
-    py::class_<ProducerConsumer>(m, "ProducerConsumer")
+    py::class_<SharedValueProducerConsumer>(m, "SharedValueProducerConsumer")
         .def(py::init<std::string>(), py::return_value_policy::reference_internal)
-        .def("store", [](ProducerConsumer &self, img::Image4K_RGB const &image)
-             { *static_cast<img::Image4K_RGB *>(self.shm_.get()) = image; })
-        .def("load", [](ProducerConsumer &self) -> std::shared_ptr<img::Image4K_RGB>
+        .def("store", [](SharedValueProducerConsumer &self, img::Image4K_RGB const &image)
+             { self.channel_.produce(image); })
+        .def("load", [](SharedValueProducerConsumer &self) -> std::shared_ptr<img::Image4K_RGB>
              {
-                 std::memcpy(self.image_.get(), self.shm_.get(), sizeof(img::Image4K_RGB));
+                 self.channel_.load(*self.image_);
                  return self.image_; }, py::return_value_policy::reference_internal);
 
     py::class_<AtomicProducerConsumer>(m, "AtomicProducerConsumer")
         .def(py::init<std::string>(), py::return_value_policy::reference_internal)
         .def("store", [](AtomicProducerConsumer &self, img::Image4K_RGB const &image)
-             { std::memcpy(self.shm_.get(), &image, sizeof(Image)); })
+             { self.channel_.produce(image); })
         .def("load", [](AtomicProducerConsumer &self) -> std::shared_ptr<img::Image4K_RGB>
              {
-                    std::memcpy(self.image_.get(), self.shm_.get(), sizeof(Image));
+                    self.channel_.load(*self.image_);
                     return self.image_; }, py::return_value_policy::reference_internal);
 }
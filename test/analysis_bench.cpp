@@ -0,0 +1,54 @@
+#include "image-shm-dblbuf/frame_analysis.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fmt/core.h>
+#include <memory>
+#include <random>
+
+// Cost of the fused copy-and-analyze kernel against a plain copy followed by separate CRC and
+// luma passes over a 4K RGB frame. Rounds are interleaved and the best of each is kept, so a
+// noisy neighbour slows both variants rather than one.
+// Usage: analysis_bench [rounds]
+
+int main(int argc, char **argv)
+{
+    using Image = img::Image4K_RGB;
+    using Clock = std::chrono::steady_clock;
+    auto const rounds = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 50ul;
+
+    auto src = std::make_unique<Image>();
+    auto dst = std::make_unique<Image>();
+    std::mt19937 rng(3);
+    for (auto &byte : src->data)
+    {
+        byte = static_cast<std::uint8_t>(rng());
+    }
+    auto const options = img::AnalysisOptions{true, true, true};
+
+    auto fused = Clock::duration::max();
+    auto separate = Clock::duration::max();
+    std::uint64_t checksum = 0; // keeps the results observable so the passes are not optimized out
+    for (unsigned long round = 0; round < rounds; ++round)
+    {
+        auto const start_fused = Clock::now();
+        auto const analysis = img::copy_and_analyze(dst.get(), *src, options);
+        auto const start_separate = Clock::now();
+        *dst = *src;
+        auto const crc = img::analyze(*dst, img::AnalysisOptions{true, false, false});
+        auto const luma = img::analyze(*dst, img::AnalysisOptions{false, true, true});
+        auto const end = Clock::now();
+        fused = std::min(fused, start_separate - start_fused);
+        separate = std::min(separate, end - start_separate);
+        checksum += analysis.crc32c + crc.crc32c + analysis.luma_max + luma.luma_histogram[32];
+    }
+
+    auto const us = [](auto d)
+    { return std::chrono::duration_cast<std::chrono::microseconds>(d).count(); };
+    fmt::print("analysis_bench: best of {} rounds (checksum {})\n", rounds, checksum);
+    fmt::print("fused copy + analysis:   {} us per frame\n", us(fused));
+    fmt::print("copy + separate passes:  {} us per frame\n", us(separate));
+    fmt::print("saving:                  {:.1f}%\n",
+               100.0 * (1.0 - std::chrono::duration<double>(fused) / std::chrono::duration<double>(separate)));
+    return 0;
+}
@@ -0,0 +1,137 @@
+#include "image-shm-dblbuf/batch_builder.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <fmt/core.h>
+
+using SmallImage = img::Image<8, 4, img::ImageType::RGB>;
+
+bool near(float a, float b)
+{
+    return std::fabs(a - b) < 1e-5f;
+}
+
+void fill(SmallImage &image)
+{
+    for (std::size_t y = 0; y < SmallImage::height; ++y)
+    {
+        for (std::size_t x = 0; x < SmallImage::width; ++x)
+        {
+            auto *pixel = image.data.data() + (y * SmallImage::width + x) * 3;
+            pixel[0] = static_cast<std::uint8_t>(x);
+            pixel[1] = static_cast<std::uint8_t>(y);
+            pixel[2] = 255;
+        }
+    }
+}
+
+void test_nchw_normalize_swizzle()
+{
+    fmt::print("Test NCHW batch with normalization and RGB -> BGR swizzle\n");
+    auto image = std::make_unique<SmallImage>();
+    image->frame_number = 7;
+    fill(*image);
+
+    auto builder = img::BatchBuilder<SmallImage>({.batch_size = 2,
+                                                  .mean = {0.5f, 0.5f, 0.5f, 0.0f},
+                                                  .std = {0.5f, 0.5f, 0.5f, 1.0f},
+                                                  .channel_order = {2, 1, 0, 3},
+                                                  .threads = 3});
+    assert(builder.add(*image) == 0);
+    assert(builder.add(*image) == 1);
+    assert(builder.full());
+    assert((builder.shape() == std::array<std::size_t, 4>{2, 3, 4, 8}));
+    assert(builder.frame_numbers()[1] == 7);
+
+    auto const *out = builder.data() + SmallImage::width * SmallImage::height * 3; // second frame
+    auto at = [&](std::size_t c, std::size_t y, std::size_t x)
+    { return out[(c * SmallImage::height + y) * SmallImage::width + x]; };
+    assert(near(at(0, 2, 5), 1.0f));                          // B = 255
+    assert(near(at(1, 2, 5), (2.0f / 255.0f - 0.5f) / 0.5f)); // G = y
+    assert(near(at(2, 2, 5), (5.0f / 255.0f - 0.5f) / 0.5f)); // R = x
+    (void)at;
+
+    builder.reset();
+    assert(builder.size() == 0);
+}
+
+void test_nhwc_resize()
+{
+    fmt::print("Test NHWC batch with nearest neighbour downscale\n");
+    auto image = std::make_unique<SmallImage>();
+    fill(*image);
+
+    auto builder = img::BatchBuilder<SmallImage>({.width = 4, .height = 2, .layout = img::TensorLayout::NHWC});
+    builder.add(*image);
+    assert((builder.shape() == std::array<std::size_t, 4>{1, 2, 4, 3}));
+
+    auto const *out = builder.data();
+    auto at = [&](std::size_t y, std::size_t x, std::size_t c)
+    { return out[(y * 4 + x) * 3 + c]; };
+    assert(near(at(1, 3, 0), 6.0f / 255.0f)); // source x = 6
+    assert(near(at(1, 3, 1), 2.0f / 255.0f)); // source y = 2
+    assert(near(at(0, 0, 2), 1.0f));
+    (void)at;
+}
+
+void test_half_output()
+{
+    fmt::print("Test fp16 batch output\n");
+    auto image = std::make_unique<SmallImage>();
+    fill(*image);
+
+    auto builder = img::BatchBuilder<SmallImage, img::Half>({});
+    builder.add(*image);
+    assert(builder.data()[2 * SmallImage::width * SmallImage::height].bits == 0x3c00); // 1.0
+    assert(builder.data()[0].bits == 0x0000);                                          // 0.0
+    assert(img::to_half(-2.0f).bits == 0xc000);
+    assert(img::to_half(65504.0f).bits == 0x7bff);
+}
+
+void test_persistent_workers()
+{
+    fmt::print("Test threaded writes match a single thread across repeated frames\n");
+    using Image = img::Image<64, 48, img::ImageType::RGBA>;
+    auto image = std::make_unique<Image>();
+    auto single = img::BatchBuilder<Image>({.batch_size = 4, .width = 40, .height = 30});
+    auto threaded = img::BatchBuilder<Image>({.batch_size = 4, .width = 40, .height = 30, .threads = 4});
+    for (std::size_t frame = 0; frame < 12; ++frame)
+    {
+        for (std::size_t i = 0; i < Image::size; ++i)
+        {
+            image->data[i] = static_cast<std::uint8_t>(i * 7 + frame);
+        }
+        single.write(frame % 4, *image);
+        threaded.write(frame % 4, *image);
+    }
+    auto const elements = 4 * 40 * 30 * 4;
+    assert(std::equal(single.data(), single.data() + elements, threaded.data()));
+    (void)elements;
+}
+
+void test_invalid_config()
+{
+    fmt::print("Test zero std is rejected\n");
+    bool thrown = false;
+    try
+    {
+        auto builder = img::BatchBuilder<SmallImage>({.std = {1.0f, 0.0f, 1.0f, 1.0f}});
+    }
+    catch (std::runtime_error const &)
+    {
+        thrown = true;
+    }
+    assert(thrown);
+    (void)thrown;
+}
+
+int main()
+{
+    test_nchw_normalize_swizzle();
+    test_nhwc_resize();
+    test_half_output();
+    test_persistent_workers();
+    test_invalid_config();
+    fmt::print("All tests passed!\n");
+    return 0;
+}
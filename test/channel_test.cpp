@@ -0,0 +1,154 @@
+#include "image-shm-dblbuf/channel.hpp"
+#include "image-shm-dblbuf/flat_shm_producer_consumer.hpp"
+#include <cassert>
+#include <fmt/core.h>
+#include <thread>
+
+struct Frame
+{
+    std::uint64_t sequence;
+    std::array<std::uint8_t, 64 * 1024 + 7> data; // odd size exercises the copy kernel tails
+};
+
+bool consistent(Frame const &frame)
+{
+    auto const expected = static_cast<std::uint8_t>(frame.sequence);
+    return std::all_of(frame.data.begin(), frame.data.end(), [expected](std::uint8_t v)
+                       { return v == expected; });
+}
+
+void test_handshake_is_lossless()
+{
+    fmt::print("Test FlatShmProducerConsumer (handshake channel) delivers every value in order\n");
+    constexpr std::uint64_t N = 200;
+    auto producer = flat_shm::FlatShmProducerConsumer<Frame>("channel_handshake_test");
+    auto consumer = flat_shm::FlatShmProducerConsumer<Frame>("channel_handshake_test");
+
+    std::thread reader([&]
+                       {
+                           for (std::uint64_t i = 1; i <= N; ++i)
+                           {
+                               consumer.consume([&](Frame const &frame)
+                                                {
+                                                    assert(frame.sequence == i && "Handshake must not drop values");
+                                                    assert(consistent(frame));
+                                                    (void)frame; });
+                           }
+                       });
+    auto frame = std::make_unique<Frame>();
+    for (std::uint64_t i = 1; i <= N; ++i)
+    {
+        frame->sequence = i;
+        frame->data.fill(static_cast<std::uint8_t>(i));
+        producer.produce(*frame);
+    }
+    reader.join();
+}
+
+template <typename CHANNEL>
+void run_latest_value(std::string const &name)
+{
+    constexpr std::uint64_t N = 2000;
+    auto producer = CHANNEL(name);
+    auto consumer = CHANNEL(name);
+    auto const base = producer.sequence(); // the segment may outlive a previous run
+
+    std::thread reader([&]
+                       {
+                           auto frame = std::make_unique<Frame>();
+                           std::uint64_t last = 0;
+                           std::size_t received = 0;
+                           while (last < N)
+                           {
+                               consumer.load(*frame);
+                               assert(consistent(*frame) && "Torn read");
+                               assert((frame->sequence > last || received == 0) && "Sequence must move forward");
+                               last = frame->sequence;
+                               ++received;
+                           }
+                           fmt::print("{}: received {} of {} values\n", name, received, N); });
+    auto frame = std::make_unique<Frame>();
+    for (std::uint64_t i = 1; i <= N; ++i)
+    {
+        frame->sequence = i;
+        frame->data.fill(static_cast<std::uint8_t>(i));
+        producer.produce(*frame);
+    }
+    reader.join();
+    assert(producer.sequence() == base + N);
+    (void)base;
+}
+
+void test_latest_value_channels()
+{
+    fmt::print("Test latest-value channels never tear and never go backwards\n");
+    using namespace flat_shm;
+    run_latest_value<LatestValueChannel<Frame>>("channel_seqlock_test");
+    run_latest_value<LockedChannel<Frame>>("channel_locked_test");
+    run_latest_value<Channel<Frame, 4, sync::SeqLock, copy::Streaming, notify::Poll>>("channel_streaming_test");
+}
+
+void test_streaming_copy()
+{
+    fmt::print("Test streaming copy kernel at unaligned offsets\n");
+    struct Odd
+    {
+        char bytes[1000];
+    };
+    auto src = std::make_unique<Odd>();
+    auto dst = std::make_unique<std::array<char, 1100>>();
+    for (std::size_t i = 0; i < sizeof(Odd); ++i)
+    {
+        src->bytes[i] = static_cast<char>(i * 31);
+    }
+    for (std::size_t offset = 0; offset < 16; ++offset)
+    {
+        dst->fill(0);
+        flat_shm::copy::Streaming::copy(*reinterpret_cast<Odd *>(dst->data() + offset), *src);
+        assert(std::memcmp(dst->data() + offset, src->bytes, sizeof(Odd)) == 0);
+        assert((*dst)[offset + sizeof(Odd)] == 0 && "Copy must not overrun");
+    }
+}
+
+void test_shared_value_channel()
+{
+    fmt::print("Test shared value channel overwrites and loads without waiting\n");
+    auto producer = flat_shm::SharedValueChannel<Frame>("channel_shared_value_test");
+    auto consumer = flat_shm::SharedValueChannel<Frame, flat_shm::copy::Memcpy>("channel_shared_value_test");
+    auto frame = std::make_unique<Frame>();
+    auto out = std::make_unique<Frame>();
+    for (std::uint64_t i = 1; i <= 3; ++i)
+    {
+        frame->sequence = i;
+        frame->data.fill(static_cast<std::uint8_t>(i));
+        producer.produce(*frame);
+    }
+    // Only the last store is kept, and loading it again does not block
+    consumer.load(*out);
+    assert(out->sequence == 3 && consistent(*out));
+    consumer.load(*out);
+    assert(out->sequence == 3);
+}
+
+void test_realtime_segment()
+{
+    fmt::print("Test realtime profile pre-faults the channel segment\n");
+    auto channel = flat_shm::LatestValueChannel<Frame>("channel_realtime_test");
+    rt::RealtimeProfile profile;
+    profile.prefault = true;
+    auto const report = channel.apply_realtime(profile);
+    assert(report.prefault.requested && report.prefault.applied);
+    assert(!report.affinity.requested && !report.scheduling.requested && "Thread settings stay with the caller");
+    (void)report;
+}
+
+int main()
+{
+    test_handshake_is_lossless();
+    test_latest_value_channels();
+    test_streaming_copy();
+    test_shared_value_channel();
+    test_realtime_segment();
+    fmt::print("All tests passed!\n");
+    return 0;
+}
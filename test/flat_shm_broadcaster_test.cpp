@@ -0,0 +1,208 @@
+#include "image-shm-dblbuf/flat_shm_broadcaster.hpp"
+#include <cassert>
+#include <cstring>
+#include <fmt/core.h>
+#include <random>
+#include <thread>
+
+struct Frame
+{
+    std::uint64_t frame_number;
+    char payload[256];
+};
+
+void test_filters()
+{
+    fmt::print("Test broadcaster delivers by rate and every-Nth filters\n");
+    using namespace flat_shm;
+    constexpr std::uint64_t FRAME_PERIOD_NS = 16'666'667; // 60 fps
+
+    auto broadcaster = FlatShmBroadcaster<Frame, 4>("broadcaster_filter_test");
+    auto recorder = FlatShmSubscriber<Frame, 4>("broadcaster_filter_test", SubscriptionFilter{});
+    auto analytics = FlatShmSubscriber<Frame, 4>("broadcaster_filter_test", SubscriptionFilter::rate(15.0));
+    auto preview = FlatShmSubscriber<Frame, 4>("broadcaster_filter_test", SubscriptionFilter::every(12));
+
+    auto const base = broadcaster.sequence(); // the segment may outlive a previous run
+    int recorder_count = 0, analytics_count = 0, preview_count = 0;
+    auto frame = Frame{};
+    for (std::uint64_t i = 1; i <= 60; ++i)
+    {
+        auto const before = std::array{recorder.delivered_sequence(), analytics.delivered_sequence(), preview.delivered_sequence()};
+        frame.frame_number = i;
+        broadcaster.produce(frame, i * FRAME_PERIOD_NS);
+        recorder_count += recorder.delivered_sequence() != before[0];
+        analytics_count += analytics.delivered_sequence() != before[1];
+        preview_count += preview.delivered_sequence() != before[2];
+    }
+    fmt::print("Delivered: recorder {}, analytics {}, preview {}\n", recorder_count, analytics_count, preview_count);
+    assert(recorder_count == 60);
+    assert(analytics_count == 15);
+    assert(preview_count == 5);
+    assert(broadcaster.sequence() == base + 60);
+
+    // Wake-ups are coalesced: the subscriber sees the latest frame
+    std::uint64_t seen = 0;
+    preview.consume([&](Frame const &f)
+                    { seen = f.frame_number; });
+    assert(seen == 60);
+    assert(preview.delivered_sequence() == base + 60);
+    (void)seen;
+    (void)base;
+}
+
+void test_jittered_rate()
+{
+    fmt::print("Test rate filter keeps its rate under producer jitter\n");
+    using namespace flat_shm;
+    constexpr std::int64_t FRAME_PERIOD_NS = 16'666'667; // 60 fps
+    constexpr std::int64_t JITTER_NS = 2'000'000;
+    constexpr std::int64_t FRAMES = 600;                 // ten seconds
+
+    auto broadcaster = FlatShmBroadcaster<Frame, 2>("broadcaster_jitter_test");
+    auto analytics = FlatShmSubscriber<Frame, 2>("broadcaster_jitter_test", SubscriptionFilter::rate(15.0));
+
+    auto rng = std::mt19937(42);
+    auto jitter = std::uniform_int_distribution<std::int64_t>(-JITTER_NS, JITTER_NS);
+    int delivered = 0;
+    auto frame = Frame{};
+    for (std::int64_t i = 1; i <= FRAMES; ++i)
+    {
+        auto const before = analytics.delivered_sequence();
+        frame.frame_number = static_cast<std::uint64_t>(i);
+        broadcaster.produce(frame, static_cast<std::uint64_t>(i * FRAME_PERIOD_NS + jitter(rng)));
+        delivered += analytics.delivered_sequence() != before;
+    }
+    fmt::print("Delivered {} of {} frames at rate(15)\n", delivered, FRAMES);
+    assert(delivered >= 149 && delivered <= 151);
+    (void)delivered;
+}
+
+void test_slots()
+{
+    fmt::print("Test broadcaster subscription slots are limited and reusable\n");
+    using namespace flat_shm;
+    auto broadcaster = FlatShmBroadcaster<Frame, 2>("broadcaster_slot_test");
+    auto first = FlatShmSubscriber<Frame, 2>("broadcaster_slot_test", SubscriptionFilter{});
+    {
+        auto second = FlatShmSubscriber<Frame, 2>("broadcaster_slot_test", SubscriptionFilter{});
+        assert(second.index() == 1);
+        bool thrown = false;
+        try
+        {
+            auto third = FlatShmSubscriber<Frame, 2>("broadcaster_slot_test", SubscriptionFilter{});
+        }
+        catch (std::runtime_error const &)
+        {
+            thrown = true;
+        }
+        assert(thrown && "All slots are taken");
+        (void)thrown;
+    }
+    auto again = FlatShmSubscriber<Frame, 2>("broadcaster_slot_test", SubscriptionFilter{});
+    assert(again.index() == 1 && "Released slot should be reused");
+}
+
+void test_resubscribe_pending()
+{
+    fmt::print("Test reclaimed slot does not inherit a pending wake-up\n");
+    using namespace flat_shm;
+    auto broadcaster = FlatShmBroadcaster<Frame, 2>("broadcaster_resubscribe_test");
+    auto frame = Frame{};
+    std::size_t index = 0;
+    {
+        auto leaving = FlatShmSubscriber<Frame, 2>("broadcaster_resubscribe_test", SubscriptionFilter{});
+        index = leaving.index();
+        frame.frame_number = 1;
+        broadcaster.produce(frame); // never consumed
+    }
+    auto subscriber = FlatShmSubscriber<Frame, 2>("broadcaster_resubscribe_test", SubscriptionFilter::every(2));
+    assert(subscriber.index() == index && "Released slot should be reused");
+    (void)index;
+
+    std::atomic<bool> done{false};
+    auto out = Frame{};
+    std::thread consumer([&]
+                         {
+                             subscriber.load(out);
+                             done.store(true);
+                         });
+    frame.frame_number = 2;
+    broadcaster.produce(frame); // filtered out by every(2)
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    assert(!done.load() && "Stale wake-up of the previous subscriber was delivered");
+    frame.frame_number = 3;
+    broadcaster.produce(frame);
+    consumer.join();
+    assert(out.frame_number == 3);
+}
+
+void test_blocking_consume()
+{
+    fmt::print("Test slow subscriber callback does not block the producer\n");
+    using namespace flat_shm;
+    using Clock = std::chrono::steady_clock;
+    constexpr auto FRAME_PERIOD = std::chrono::milliseconds(2);
+    constexpr auto CALLBACK_TIME = std::chrono::milliseconds(20); // ten frame periods
+    auto broadcaster = FlatShmBroadcaster<Frame, 2>("broadcaster_block_test");
+    auto subscriber = FlatShmSubscriber<Frame, 2>("broadcaster_block_test", SubscriptionFilter{});
+
+    std::thread consumer([&]
+                         {
+                             for (int i = 0; i < 3; ++i)
+                             {
+                                 subscriber.consume([&](Frame const &f)
+                                                    {
+                                                        std::this_thread::sleep_for(CALLBACK_TIME);
+                                                        // the callback's copy is stable while the producer moves on
+                                                        for (auto byte : f.payload)
+                                                        {
+                                                            assert(byte == static_cast<char>(f.frame_number));
+                                                            (void)byte;
+                                                        }
+                                                    });
+                             }
+                         });
+    auto frame = Frame{};
+    auto slowest = Clock::duration::zero();
+    for (std::uint64_t i = 1; i <= 40; ++i)
+    {
+        frame.frame_number = i;
+        std::memset(frame.payload, static_cast<char>(i), sizeof(frame.payload));
+        auto const start = Clock::now();
+        broadcaster.produce(frame);
+        slowest = std::max(slowest, Clock::now() - start);
+        std::this_thread::sleep_for(FRAME_PERIOD);
+    }
+    consumer.join();
+    fmt::print("Slowest produce: {} us\n", std::chrono::duration_cast<std::chrono::microseconds>(slowest).count());
+    assert(slowest < CALLBACK_TIME / 2 && "produce must not wait for a subscriber callback");
+}
+
+void test_load()
+{
+    fmt::print("Test subscriber load copies the latest frame\n");
+    using namespace flat_shm;
+    auto broadcaster = FlatShmBroadcaster<Frame, 2>("broadcaster_load_test");
+    auto subscriber = FlatShmSubscriber<Frame, 2>("broadcaster_load_test", SubscriptionFilter{});
+    auto frame = Frame{};
+    for (std::uint64_t i = 1; i <= 5; ++i)
+    {
+        frame.frame_number = i;
+        broadcaster.produce(frame);
+    }
+    auto out = Frame{};
+    subscriber.load(out);
+    assert(out.frame_number == 5);
+}
+
+int main()
+{
+    test_filters();
+    test_jittered_rate();
+    test_slots();
+    test_resubscribe_pending();
+    test_blocking_consume();
+    test_load();
+    fmt::print("All tests passed!\n");
+    return 0;
+}
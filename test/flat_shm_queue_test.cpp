@@ -0,0 +1,216 @@
+#include "image-shm-dblbuf/flat_shm_queue.hpp"
+#include <cassert>
+#include <fmt/core.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+struct Detection
+{
+    std::uint32_t producer;
+    std::uint32_t index;
+    float box[4];
+};
+
+template <typename QUEUE>
+void drain(QUEUE &queue)
+{
+    // the segment may outlive a previous run
+    auto record = Detection{};
+    while (queue.try_load(record))
+    {
+    }
+}
+
+void test_single_process()
+{
+    fmt::print("Test queue order, full / empty reporting and batches\n");
+    using Queue = flat_shm::MpscQueue<Detection, 8>;
+    auto queue = Queue("queue_basic_test");
+    drain(queue);
+
+    auto record = Detection{};
+    assert(!queue.try_load(record) && "Empty queue must report empty");
+    for (std::uint32_t i = 0; i < Queue::capacity; ++i)
+    {
+        bool const produced = queue.try_produce(Detection{0, i, {}});
+        assert(produced);
+        (void)produced;
+    }
+    assert(!queue.try_produce(Detection{}) && "Full queue must report full");
+    assert(queue.size_approx() == Queue::capacity);
+
+    std::array<Detection, 5> out{};
+    auto count = queue.try_load_batch(out);
+    assert(count == 5);
+    for (std::uint32_t i = 0; i < count; ++i)
+    {
+        assert(out[i].index == i);
+    }
+
+    // Only the 5 freed cells are taken from a batch of 6
+    std::array<Detection, 6> in{};
+    for (std::uint32_t i = 0; i < in.size(); ++i)
+    {
+        in[i].index = 100 + i;
+    }
+    count = queue.produce_batch(in);
+    assert(count == 5);
+
+    std::vector<std::uint32_t> order;
+    while (queue.try_consume([&](Detection const &d)
+                             { order.push_back(d.index); }))
+    {
+    }
+    assert((order == std::vector<std::uint32_t>{5, 6, 7, 100, 101, 102, 103, 104}));
+    (void)record;
+    (void)count;
+}
+
+void test_multi_process_producers()
+{
+    fmt::print("Test forked producers into one consumer lose nothing and keep per-producer order\n");
+    using Queue = flat_shm::MpscQueue<Detection, 256>;
+    constexpr std::uint32_t PRODUCERS = 4;
+    constexpr std::uint32_t PER_PRODUCER = 20000;
+    auto queue = Queue("queue_mpsc_test");
+    drain(queue);
+
+    std::vector<pid_t> children;
+    for (std::uint32_t p = 0; p < PRODUCERS; ++p)
+    {
+        auto const pid = ::fork();
+        if (pid == 0)
+        {
+            auto producer = Queue("queue_mpsc_test");
+            std::array<Detection, 8> batch{};
+            for (std::uint32_t i = 0; i < PER_PRODUCER;)
+            {
+                auto const n = std::min<std::uint32_t>(static_cast<std::uint32_t>(batch.size()), PER_PRODUCER - i);
+                for (std::uint32_t k = 0; k < n; ++k)
+                {
+                    batch[k] = Detection{p, i + k, {}};
+                }
+                auto const sent = producer.produce_batch(std::span<Detection const>(batch.data(), n));
+                if (sent == 0)
+                {
+                    std::this_thread::yield();
+                }
+                i += static_cast<std::uint32_t>(sent);
+            }
+            ::_exit(0);
+        }
+        children.push_back(pid);
+    }
+
+    std::array<std::uint32_t, PRODUCERS> next{};
+    std::array<Detection, 32> out{};
+    std::uint64_t received = 0;
+    while (received < PRODUCERS * PER_PRODUCER)
+    {
+        auto const count = queue.load_batch(out);
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            assert(out[i].producer < PRODUCERS);
+            assert(out[i].index == next[out[i].producer] && "Records of one producer must stay in order");
+            ++next[out[i].producer];
+        }
+        received += count;
+    }
+    for (auto pid : children)
+    {
+        int status = 0;
+        ::waitpid(pid, &status, 0);
+        assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    }
+    assert(queue.size_approx() == 0);
+    fmt::print("Received {} records from {} processes\n", received, PRODUCERS);
+}
+
+void test_multi_consumer()
+{
+    fmt::print("Test MPMC queue delivers every record exactly once\n");
+    using Queue = flat_shm::MpmcQueue<Detection, 64>;
+    constexpr std::uint32_t PRODUCERS = 3;
+    constexpr std::uint32_t CONSUMERS = 3;
+    constexpr std::uint32_t PER_PRODUCER = 20000;
+    auto queue = Queue("queue_mpmc_test");
+    drain(queue);
+
+    std::vector<std::atomic<std::uint32_t>> seen(PRODUCERS * PER_PRODUCER);
+    std::atomic<std::uint32_t> remaining = PRODUCERS * PER_PRODUCER;
+    {
+        std::vector<std::jthread> threads;
+        for (std::uint32_t c = 0; c < CONSUMERS; ++c)
+        {
+            threads.emplace_back([&]
+                                 {
+                                     auto consumer = Queue("queue_mpmc_test");
+                                     while (remaining.load() != 0)
+                                     {
+                                         auto record = Detection{};
+                                         if (!consumer.try_load(record))
+                                         {
+                                             std::this_thread::yield();
+                                             continue;
+                                         }
+                                         seen[record.producer * PER_PRODUCER + record.index].fetch_add(1);
+                                         remaining.fetch_sub(1);
+                                     } });
+        }
+        for (std::uint32_t p = 0; p < PRODUCERS; ++p)
+        {
+            threads.emplace_back([&, p]
+                                 {
+                                     auto producer = Queue("queue_mpmc_test");
+                                     for (std::uint32_t i = 0; i < PER_PRODUCER;)
+                                     {
+                                         if (producer.try_produce(Detection{p, i, {}}))
+                                         {
+                                             ++i;
+                                         }
+                                         else
+                                         {
+                                             std::this_thread::yield();
+                                         }
+                                     } });
+        }
+    }
+    for (auto const &count : seen)
+    {
+        assert(count.load() == 1 && "Every record must be delivered exactly once");
+        (void)count;
+    }
+}
+
+void test_blocking_consume()
+{
+    fmt::print("Test consumer sleeps on the futex until a record arrives\n");
+    using Queue = flat_shm::MpscQueue<Detection, 16>;
+    auto queue = Queue("queue_blocking_test");
+    drain(queue);
+
+    std::uint32_t index = 0;
+    std::thread consumer([&]
+                         { queue.consume([&](Detection const &d)
+                                         { index = d.index; }); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    auto producer = Queue("queue_blocking_test");
+    bool const produced = producer.try_produce(Detection{0, 42, {}});
+    assert(produced);
+    consumer.join();
+    assert(index == 42);
+    (void)produced;
+    (void)index;
+}
+
+int main()
+{
+    test_single_process();
+    test_multi_process_producers();
+    test_multi_consumer();
+    test_blocking_consume();
+    fmt::print("All tests passed!\n");
+    return 0;
+}
@@ -0,0 +1,112 @@
+#include "image-shm-dblbuf/frame_analysis.hpp"
+#include <cassert>
+#include <cstring>
+#include <fmt/core.h>
+#include <memory>
+#include <random>
+
+void test_crc32c()
+{
+    fmt::print("Test CRC-32C check value\n");
+    auto const check = std::string_view("123456789");
+    auto const crc = img::crc32c(reinterpret_cast<std::uint8_t const *>(check.data()), check.size());
+    assert(crc == 0xE3069283u);
+    // Chained updates match a single pass
+    auto partial = img::crc32c_update(~0u, reinterpret_cast<std::uint8_t const *>(check.data()), 4);
+    partial = img::crc32c_update(partial, reinterpret_cast<std::uint8_t const *>(check.data()) + 4, check.size() - 4);
+    assert(~partial == crc);
+    // The table fallback agrees with the dispatched implementation on unaligned lengths
+    std::array<std::uint8_t, 1021> bytes;
+    std::mt19937 rng(7);
+    for (auto &byte : bytes)
+    {
+        byte = static_cast<std::uint8_t>(rng());
+    }
+    assert(img::detail::crc32c_update_table(~0u, bytes.data(), bytes.size()) == img::crc32c_update(~0u, bytes.data(), bytes.size()));
+    (void)crc;
+    (void)partial;
+}
+
+// Straightforward separate passes the fused kernel must agree with
+template <typename IMAGE>
+img::FrameAnalysis reference(IMAGE const &image)
+{
+    img::FrameAnalysis analysis{};
+    analysis.crc32c = img::crc32c(image.data.data(), IMAGE::size);
+    std::uint64_t sum = 0;
+    std::size_t count = 0;
+    analysis.luma_min = UINT8_MAX;
+    auto add = [&](std::uint8_t y)
+    {
+        sum += y;
+        ++count;
+        analysis.luma_min = std::min(analysis.luma_min, y);
+        analysis.luma_max = std::max(analysis.luma_max, y);
+        ++analysis.luma_histogram[y / (256 / img::LUMA_HISTOGRAM_BINS)];
+    };
+    if constexpr (IMAGE::type == img::ImageType::NV12)
+    {
+        for (std::size_t i = 0; i < IMAGE::width * IMAGE::height; ++i)
+        {
+            add(image.data[i]);
+        }
+    }
+    else
+    {
+        constexpr auto channels = static_cast<std::size_t>(img::channels(IMAGE::type));
+        for (std::size_t i = 0; i < IMAGE::width * IMAGE::height; ++i)
+        {
+            auto const *p = image.data.data() + i * channels;
+            add(static_cast<std::uint8_t>((77u * p[0] + 150u * p[1] + 29u * p[2] + 128u) >> 8));
+        }
+    }
+    analysis.luma_mean = static_cast<double>(sum) / static_cast<double>(count);
+    return analysis;
+}
+
+template <typename IMAGE>
+void check_fused(char const *name)
+{
+    fmt::print("Test fused copy and analysis matches separate passes for {}\n", name);
+    auto src = std::make_unique<IMAGE>();
+    auto dst = std::make_unique<IMAGE>();
+    src->timestamp = 5;
+    src->frame_number = 6;
+    std::mt19937 rng(42);
+    for (auto &byte : src->data)
+    {
+        byte = static_cast<std::uint8_t>(rng() % 200 + 20);
+    }
+
+    auto const options = img::AnalysisOptions{true, true, true};
+    auto const fused = img::copy_and_analyze(dst.get(), *src, options);
+    auto const expected = reference(*src);
+
+    assert(std::memcmp(dst->data.data(), src->data.data(), IMAGE::size) == 0 && "Copy must be exact");
+    assert(dst->timestamp == 5 && dst->frame_number == 6);
+    assert(fused.computed.crc32c && fused.computed.histogram && fused.computed.stats);
+    assert(fused.crc32c == expected.crc32c);
+    assert(fused.luma_min == expected.luma_min);
+    assert(fused.luma_max == expected.luma_max);
+    assert(fused.luma_mean == expected.luma_mean);
+    assert(fused.luma_histogram == expected.luma_histogram);
+
+    // Analysis without a copy, and only the requested metrics
+    auto const crc_only = img::analyze(*src, img::AnalysisOptions{true, false, false});
+    assert(crc_only.crc32c == expected.crc32c);
+    assert(!crc_only.computed.stats && crc_only.luma_max == 0);
+    (void)fused;
+    (void)expected;
+    (void)crc_only;
+}
+
+int main()
+{
+    test_crc32c();
+    check_fused<img::Image<320, 240, img::ImageType::RGB>>("RGB");
+    check_fused<img::Image<320, 240, img::ImageType::RGBA>>("RGBA");
+    check_fused<img::Image<320, 240, img::ImageType::NV12>>("NV12");
+    check_fused<img::Image<33, 7, img::ImageType::RGB>>("RGB with a partial SIMD tail");
+    fmt::print("All tests passed!\n");
+    return 0;
+}
@@ -0,0 +1,77 @@
+#include "image-shm-dblbuf/frame_pool.hpp"
+#include "image-shm-dblbuf/image.hpp"
+#include <algorithm>
+#include <cassert>
+#include <fmt/core.h>
+
+void test_recycle_without_zero_fill()
+{
+    fmt::print("Test frame pool recycles blocks\n");
+    auto &pool = img::FramePool::of<img::ImageFHD_RGB>();
+    void *first_address = nullptr;
+    {
+        auto image = img::make_pooled<img::ImageFHD_RGB>();
+        image->timestamp = 7;
+        image->frame_number = 42;
+        first_address = image.get();
+    }
+    assert(pool.stats().free == 1);
+
+    // Pixel contents of a recycled frame are unspecified, only the header is reset
+    auto image = img::make_pooled<img::ImageFHD_RGB>();
+    assert(image.get() == first_address && "Released block should be handed out again");
+    assert(image->timestamp == 0 && image->frame_number == 0 && "Header must not leak the previous frame");
+    assert(pool.stats().blocks == 1);
+    (void)pool;
+    (void)first_address;
+}
+
+void test_size_classes_and_shared()
+{
+    fmt::print("Test frame pool size classes and shared ownership\n");
+    assert(&img::FramePool::of<img::Image4K_RGB>() != &img::FramePool::of<img::ImageFHD_RGB>());
+    assert(&img::FramePool::of<img::Image4K_RGB>() == &img::FramePool::instance(sizeof(img::Image4K_RGB)));
+    assert(img::FramePool::of<img::Image4K_RGB>().block_size() % img::FramePool::PAGE_SIZE == 0);
+
+    auto &pool = img::FramePool::of<img::Image4K_RGB>();
+    pool.reserve(2);
+    assert(pool.stats().free >= 2);
+    {
+        auto first = img::make_pooled_shared<img::Image4K_RGB>();
+        auto second = first;
+        assert(pool.stats().free >= 1);
+    }
+    auto const free = pool.stats().free;
+    assert(free >= 2 && "Shared frame should return to the pool");
+    pool.trim();
+    assert(pool.stats().free == 0 && pool.stats().blocks == 0);
+    (void)free;
+}
+
+void test_huge_pages_option()
+{
+    fmt::print("Test frame pool huge page option falls back when no huge pages are reserved\n");
+    auto &pool = img::FramePool::of<img::Image4K_RGBA>();
+    pool.configure({.huge_pages = true, .prefault = true});
+    auto const blocks_before = pool.stats().blocks;
+    auto const free_before = pool.stats().free;
+    auto image = img::make_pooled<img::Image4K_RGBA>();
+    assert((free_before > 0 || pool.stats().blocks == blocks_before + 1) && "A block must be mapped when none is free");
+
+    // The block is usable end to end whether or not it is backed by huge pages
+    std::fill(image->data.begin(), image->data.end(), std::uint8_t{0x5A});
+    assert(image->data.front() == 0x5A && image->data.back() == 0x5A);
+    assert(pool.stats().huge_pages <= pool.stats().blocks);
+    fmt::print("Huge page blocks: {}\n", pool.stats().huge_pages);
+    (void)blocks_before;
+    (void)free_before;
+}
+
+int main()
+{
+    test_recycle_without_zero_fill();
+    test_size_classes_and_shared();
+    test_huge_pages_option();
+    fmt::print("All tests passed!\n");
+    return 0;
+}
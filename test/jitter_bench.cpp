@@ -0,0 +1,138 @@
+#include "image-shm-dblbuf/channel.hpp"
+#include "image-shm-dblbuf/realtime.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fmt/core.h>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// Transport latency under synthetic CPU load, with and without the real-time profile applied to
+// the transport threads, the channel segment and the sample buffers.
+// Usage: jitter_bench [samples] [period_us]
+
+struct Sample
+{
+    std::uint64_t sent_ns;
+    std::array<std::uint8_t, 256 * 1024> payload;
+};
+
+std::uint64_t now_ns()
+{
+    return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                          std::chrono::steady_clock::now().time_since_epoch())
+                                          .count());
+}
+
+struct Percentiles
+{
+    double p50, p99, p999, max;
+};
+
+Percentiles percentiles(std::vector<std::uint64_t> latencies)
+{
+    if (latencies.empty())
+    {
+        return {};
+    }
+    std::sort(latencies.begin(), latencies.end());
+    auto at = [&](double q)
+    { return static_cast<double>(latencies[static_cast<std::size_t>(q * static_cast<double>(latencies.size() - 1))]) / 1000.0; };
+    return {at(0.5), at(0.99), at(0.999), at(1.0)};
+}
+
+Percentiles run(std::string const &name, std::size_t samples, std::chrono::microseconds period, rt::RealtimeProfile const *profile)
+{
+    using Channel = flat_shm::LatestValueChannel<Sample>;
+    std::atomic<bool> stop = false;
+
+    // One busy thread per CPU competes with the transport threads
+    std::vector<std::jthread> load;
+    for (unsigned i = 0; i < std::max(1u, std::thread::hardware_concurrency()); ++i)
+    {
+        load.emplace_back([&stop]
+                          {
+                              volatile std::uint64_t spin = 0;
+                              while (!stop.load(std::memory_order_relaxed))
+                              {
+                                  spin = spin + 1;
+                              } });
+    }
+
+    std::vector<std::uint64_t> latencies;
+    latencies.reserve(samples);
+    std::atomic<std::size_t> received = 0;
+    std::jthread consumer([&]
+                          {
+                              auto channel = Channel(name);
+                              auto sample = std::make_unique<Sample>();
+                              if (profile)
+                              {
+                                  auto report = rt::apply_to_current_thread(*profile);
+                                  rt::apply_to_memory(sample.get(), sizeof(Sample), *profile, report);
+                                  fmt::print("  consumer profile: {}\n", report.summary());
+                                  fmt::print("  consumer channel: {}\n", channel.apply_realtime(*profile).summary());
+                              }
+                              while (latencies.size() < samples && !stop.load(std::memory_order_relaxed))
+                              {
+                                  channel.load(*sample);
+                                  latencies.push_back(now_ns() - sample->sent_ns);
+                                  received.store(latencies.size(), std::memory_order_relaxed);
+                              } });
+
+    {
+        auto channel = Channel(name);
+        auto sample = std::make_unique<Sample>();
+        if (profile)
+        {
+            auto report = rt::apply_to_current_thread(*profile);
+            rt::apply_to_memory(sample.get(), sizeof(Sample), *profile, report);
+            fmt::print("  producer profile: {}\n", report.summary());
+            fmt::print("  producer channel: {}\n", channel.apply_realtime(*profile).summary());
+        }
+        auto next = std::chrono::steady_clock::now();
+        // a few extra sends so the consumer always gets its last samples even if it skips some
+        for (std::size_t i = 0; i < samples * 2 && received.load(std::memory_order_relaxed) < samples; ++i)
+        {
+            next += period;
+            std::this_thread::sleep_until(next);
+            sample->payload[i % sample->payload.size()] = static_cast<std::uint8_t>(i);
+            sample->sent_ns = now_ns();
+            channel.produce(*sample);
+        }
+        stop = true;
+        sample->sent_ns = now_ns();
+        channel.produce(*sample); // release a consumer still waiting
+    }
+    consumer.join();
+    return percentiles(latencies);
+}
+
+void print(char const *label, Percentiles const &p)
+{
+    fmt::print("{:<12} p50 {:>9.1f} us   p99 {:>9.1f} us   p99.9 {:>9.1f} us   max {:>9.1f} us\n", label, p.p50, p.p99, p.p999, p.max);
+}
+
+int main(int argc, char **argv)
+{
+    auto const samples = argc > 1 ? static_cast<std::size_t>(std::strtoul(argv[1], nullptr, 10)) : std::size_t{2000};
+    auto const period = std::chrono::microseconds(argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 1000);
+
+    rt::RealtimeProfile profile;
+    profile.cpus = {static_cast<int>(std::max(1u, std::thread::hardware_concurrency()) - 1)};
+    profile.policy = rt::SchedulingPolicy::FIFO;
+    profile.priority = 80;
+    profile.lock_memory = true;
+    profile.prefault = true;
+
+    fmt::print("jitter_bench: {} samples every {} us, {} load threads\n", samples, period.count(), std::thread::hardware_concurrency());
+    fmt::print("Without profile\n");
+    auto const baseline = run("jitter_bench_default", samples, period, nullptr);
+    fmt::print("With profile\n");
+    auto const tuned = run("jitter_bench_realtime", samples, period, &profile);
+    print("default", baseline);
+    print("realtime", tuned);
+    return 0;
+}
@@ -0,0 +1,180 @@
+#include "image-shm-dblbuf/memfd.hpp"
+#include <atomic>
+#include <cassert>
+#include <fstream>
+#include <fmt/core.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+struct Message
+{
+    int sequence;
+    char text[32];
+};
+
+void test_sealed_segment()
+{
+    fmt::print("Test memfd segment is sealed against resizing\n");
+    auto segment = memfd::Segment::create("memfd_sealed_test", 4096);
+    assert(segment.get() != nullptr);
+    assert(segment.size() == 4096);
+    assert(::ftruncate(segment.fd(), 8192) != 0 && "Sealed segment must not grow");
+    assert(::ftruncate(segment.fd(), 0) != 0 && "Sealed segment must not shrink");
+    static_cast<char *>(segment.get())[4095] = 'x';
+}
+
+void test_channel_between_processes()
+{
+    fmt::print("Test memfd channel handshake and transfer between processes\n");
+    auto const socket_name = fmt::format("memfd_channel_test_{}", ::getpid());
+    constexpr int N = 100;
+
+    auto producer = memfd::FlatChannel<Message>::create(socket_name);
+
+    pid_t pid = fork();
+    assert(pid >= 0 && "Failed to fork");
+    if (pid == 0)
+    {
+        auto consumer = memfd::FlatChannel<Message>::connect(socket_name);
+        for (int i = 0; i < N; ++i)
+        {
+            bool ok = true;
+            consumer.consume([&](Message const &message)
+                             { ok = message.sequence == i && std::string_view(message.text) == "hello"; });
+            if (!ok)
+            {
+                fmt::print("Data mismatch in consumer at {}\n", i);
+                _exit(EXIT_FAILURE);
+            }
+        }
+        _exit(EXIT_SUCCESS);
+    }
+
+    for (int i = 0; i < N; ++i)
+    {
+        producer.produce({i, "hello"});
+    }
+
+    int status = 0;
+    waitpid(pid, &status, 0);
+    assert(WIFEXITED(status) && WEXITSTATUS(status) == 0 && "Consumer process failed");
+    (void)status;
+}
+
+void test_connect_without_producer()
+{
+    fmt::print("Test memfd connect fails without a producer\n");
+    bool thrown = false;
+    try
+    {
+        auto consumer = memfd::FlatChannel<Message>::connect("memfd_missing_producer");
+    }
+    catch (std::runtime_error const &)
+    {
+        thrown = true;
+    }
+    assert(thrown && "Connecting to a missing producer should throw");
+    (void)thrown;
+}
+
+void test_moved_channel()
+{
+    fmt::print("Test memfd channel keeps working after its owner is moved\n");
+    auto const socket_name = fmt::format("memfd_moved_test_{}", ::getpid());
+    auto const other_name = fmt::format("memfd_moved_other_{}", ::getpid());
+
+    auto created = memfd::FlatChannel<Message>::create(socket_name);
+    auto moved = std::move(created);
+    auto other = memfd::FlatChannel<Message>::create(other_name);
+    auto producer = memfd::FlatChannel<Message>::connect(other_name);
+    producer = std::move(moved); // releases the consumer of other_name, takes over socket_name
+    {
+        auto gone = std::move(created); // moved-from channels own nothing
+    }
+
+    auto consumer = memfd::FlatChannel<Message>::connect(socket_name);
+    for (int i = 0; i < 3; ++i)
+    {
+        producer.produce({i, "moved"});
+        int sequence = -1;
+        consumer.consume([&](Message const &message)
+                         { sequence = message.sequence; });
+        assert(sequence == i);
+        (void)sequence;
+    }
+}
+
+void test_listener_error()
+{
+    fmt::print("Test memfd listener reports a failed handshake through its handler\n");
+    auto const socket_name = fmt::format("memfd_listener_error_{}", ::getpid());
+    std::atomic<int> errors{0};
+    {
+        auto listener = memfd::Listener(socket_name, -1, [&](std::exception const &)
+                                        { errors.fetch_add(1); });
+        bool thrown = false;
+        try
+        {
+            memfd::connect(socket_name); // the listener cannot pass an invalid descriptor
+        }
+        catch (std::runtime_error const &)
+        {
+            thrown = true;
+        }
+        assert(thrown && "The client should see the failed handshake");
+        (void)thrown;
+    }
+    assert(errors == 1 && "The listener should report the failed handshake");
+}
+
+std::size_t reserved_huge_pages()
+{
+    auto file = std::ifstream("/proc/sys/vm/nr_hugepages");
+    std::size_t pages = 0;
+    file >> pages;
+    return pages;
+}
+
+void test_huge_page_segment()
+{
+    fmt::print("Test memfd huge page segment is rounded to whole huge pages\n");
+    if (reserved_huge_pages() == 0)
+    {
+        fmt::print("Skipped: no huge pages reserved in /proc/sys/vm/nr_hugepages\n");
+        return;
+    }
+    auto const huge_page = memfd::huge_page_size(memfd::HugePages::Default);
+    auto segment = memfd::Segment::create("memfd_huge_test", 4160, memfd::HugePages::Default);
+    assert(segment.size() == huge_page && "Size must be rounded up to a whole huge page");
+    static_cast<char *>(segment.get())[segment.size() - 1] = 'x';
+
+    // The receiving side accepts the rounded size and maps the same length
+    auto duplicate = memfd::Fd(::fcntl(segment.fd(), F_DUPFD_CLOEXEC, 0));
+    auto opened = memfd::Segment::open(std::move(duplicate), 4160);
+    assert(opened.size() == segment.size());
+    assert(static_cast<char *>(opened.get())[opened.size() - 1] == 'x');
+
+    // A channel whose layout is smaller than a huge page works end to end
+    auto const socket_name = fmt::format("memfd_huge_channel_{}", ::getpid());
+    auto producer = memfd::FlatChannel<Message>::create(socket_name, memfd::HugePages::Size2MB);
+    auto consumer = memfd::FlatChannel<Message>::connect(socket_name);
+    producer.produce({7, "huge"});
+    int sequence = 0;
+    consumer.consume([&](Message const &message)
+                     { sequence = message.sequence; });
+    assert(sequence == 7);
+    (void)huge_page;
+    (void)sequence;
+}
+
+int main()
+{
+    test_sealed_segment();
+    test_huge_page_segment();
+    test_channel_between_processes();
+    test_connect_without_producer();
+    test_moved_channel();
+    test_listener_error();
+    fmt::print("All tests passed!\n");
+    return 0;
+}
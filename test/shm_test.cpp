@@ -47,9 +47,89 @@ void test_result_address_switch()
                        { return v == 0x42; }));
 }
 
+void test_metadata_peek()
+{
+    fmt::print("Test metadata peek and load_if_newer\n");
+    auto shm = DoubleBufferShem("test_peek");
+
+    auto img_ptr = img::make_pooled<Image>();
+    img_ptr->timestamp = 1000;
+    img_ptr->frame_number = 1;
+
+    auto const before = shm.peek().sequence;
+    assert(!shm.load_if_newer(before).has_value() && "Nothing new stored yet");
+
+    auto const exposure = std::array<std::byte, 4>{std::byte{1}, std::byte{2}, std::byte{3}, std::byte{4}};
+    shm.store(*img_ptr, exposure);
+
+    auto const meta = shm.peek();
+    assert(meta.sequence == before + 1);
+    assert(meta.timestamp == 1000);
+    assert(meta.frame_number == 1);
+    assert(meta.publish_time_ns != 0);
+    assert(meta.user_size == exposure.size());
+    assert(meta.user[3] == std::byte{4});
+
+    auto result = shm.load_if_newer(before);
+    assert(result.has_value() && "A newer frame was stored");
+    assert(result->frame_number() == 1);
+    assert(!shm.load_if_newer(meta.sequence).has_value() && "Already seen");
+    (void)meta;
+    (void)result;
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+}
+
+void test_store_analysis()
+{
+    fmt::print("Test store publishes the fused analysis in the metadata\n");
+    auto shm = DoubleBufferShem("test_analysis");
+    shm.set_analysis(img::AnalysisOptions{true, true, true});
+
+    auto img_ptr = img::make_pooled<Image>();
+    img_ptr->timestamp = 2000;
+    img_ptr->frame_number = 2;
+    std::fill(img_ptr->data.begin(), img_ptr->data.end(), 0x40);
+    shm.store(*img_ptr);
+
+    auto const analysis = shm.peek().analysis;
+    assert(analysis.computed.crc32c && analysis.computed.histogram && analysis.computed.stats);
+    assert(analysis.crc32c == img::crc32c(img_ptr->data.data(), Image::size));
+    assert(analysis.luma_min == 0x40 && analysis.luma_max == 0x40);
+    assert(analysis.luma_mean == 64.0);
+    assert(analysis.luma_histogram[0x40 / (256 / img::LUMA_HISTOGRAM_BINS)] == Image::width * Image::height);
+    (void)analysis;
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+}
+
+void test_realtime_profile()
+{
+    fmt::print("Test realtime profile is applied to the segments and the runner thread\n");
+    auto shm = DoubleBufferShem("test_realtime");
+
+    rt::RealtimeProfile profile;
+    profile.cpus = {0};
+    profile.prefault = true;
+    auto const report = shm.apply_realtime(profile);
+    assert(report.prefault.requested && report.prefault.applied);
+    assert(!report.memory_lock.requested);
+    assert(!report.affinity.requested && "Thread settings wait for the runner");
+
+    shm.load();
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    auto const applied = shm.realtime_report();
+    fmt::print("{}\n", applied.summary());
+    assert(applied.affinity.requested && applied.affinity.applied);
+    assert(!applied.scheduling.requested);
+    (void)report;
+    (void)applied;
+}
+
 int main()
 {
     test_result_address_switch();
+    test_metadata_peek();
+    test_store_analysis();
+    test_realtime_profile();
     fmt::print("All tests passed!\n");
     return 0;
 }
\ No newline at end of file
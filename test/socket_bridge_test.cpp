@@ -0,0 +1,201 @@
+#include "image-shm-dblbuf/flat_shm_producer_consumer.hpp"
+#include "image-shm-dblbuf/socket_bridge.hpp"
+#include <array>
+#include <cassert>
+#include <fmt/core.h>
+#include <thread>
+
+struct Frame
+{
+    std::uint64_t frame_number;
+    std::array<std::uint8_t, 4 * 1024 * 1024> data;
+};
+
+// Stands in for a shared memory channel on the receiving side
+struct LocalChannel
+{
+    std::unique_ptr<Frame> frame = std::make_unique<Frame>();
+    int produced = 0;
+
+    void produce(Frame const &value)
+    {
+        *frame = value;
+        ++produced;
+    }
+};
+
+void print_stats(std::string_view name, bridge::Stats const &stats)
+{
+    fmt::print("{}: {} frames, {:.1f} Mbit/s, latency mean {:.1f} us, max {:.1f} us, zerocopy fallbacks {}\n",
+               name, stats.frames, stats.throughput_mbps(), stats.latency_mean_us(),
+               static_cast<double>(stats.latency_max_ns) / 1e3, stats.zerocopy_fallbacks);
+}
+
+void run_transfer(bridge::Fd client, bridge::Fd const &listener, bool zerocopy)
+{
+    constexpr int N = 50;
+    auto server = bridge::accept(listener);
+
+    std::thread receiver_thread([socket = std::move(server)]() mutable
+                                {
+                                    auto receiver = bridge::Receiver<Frame>(std::move(socket));
+                                    auto channel = LocalChannel{};
+                                    while (receiver.republish(channel))
+                                    {
+                                        assert(channel.frame->frame_number == static_cast<std::uint64_t>(channel.produced - 1));
+                                        assert(channel.frame->data[12345] == static_cast<std::uint8_t>(channel.produced - 1));
+                                    }
+                                    assert(channel.produced == N && "Receiver missed frames");
+                                    assert(receiver.last_sequence() == N - 1);
+                                    print_stats("receiver", receiver.stats()); });
+
+    {
+        auto sender = bridge::Sender<Frame>(std::move(client), zerocopy);
+        auto frame = std::make_unique<Frame>();
+        for (int i = 0; i < N; ++i)
+        {
+            frame->frame_number = static_cast<std::uint64_t>(i);
+            frame->data.fill(static_cast<std::uint8_t>(i));
+            sender.send(*frame);
+        }
+        assert(sender.stats().frames == N);
+        assert(sender.stats().bytes == N * sizeof(Frame));
+        fmt::print("sender zerocopy: {}\n", sender.zerocopy());
+        print_stats("sender", sender.stats());
+    } // closing the sender ends the receiver loop
+    receiver_thread.join();
+}
+
+void test_tcp_loopback()
+{
+    fmt::print("Test bridge over TCP loopback with MSG_ZEROCOPY\n");
+    auto listener = bridge::listen_tcp(0);
+    auto const port = bridge::local_port(listener);
+    run_transfer(bridge::connect_tcp("127.0.0.1", port), listener, true);
+}
+
+void test_unix_stream()
+{
+    fmt::print("Test bridge over Unix stream socket\n");
+    auto const name = fmt::format("bridge_test_{}", ::getpid());
+    auto listener = bridge::listen_unix(name);
+    run_transfer(bridge::connect_unix(name), listener, true);
+}
+
+void test_shm_to_shm()
+{
+    fmt::print("Test bridge forwards from one shared memory channel and republishes into another\n");
+    constexpr int N = 20;
+    using Channel = flat_shm::FlatShmProducerConsumer<Frame>;
+    auto const source_name = fmt::format("bridge_source_{}", ::getpid());
+    auto const sink_name = fmt::format("bridge_sink_{}", ::getpid());
+    auto listener = bridge::listen_tcp(0);
+    auto client = bridge::connect_tcp("127.0.0.1", bridge::local_port(listener));
+    auto server = bridge::accept(listener);
+
+    std::thread camera([&]
+                       {
+                           auto source = Channel(source_name);
+                           auto frame = std::make_unique<Frame>();
+                           for (int i = 0; i < N; ++i)
+                           {
+                               frame->frame_number = static_cast<std::uint64_t>(i);
+                               frame->data.fill(static_cast<std::uint8_t>(i));
+                               source.produce(*frame);
+                           } });
+    std::thread sender_thread([&, socket = std::move(client)]() mutable
+                              {
+                                  auto source = Channel(source_name);
+                                  auto sender = bridge::Sender<Frame>(std::move(socket), true);
+                                  for (int i = 0; i < N; ++i)
+                                  {
+                                      sender.forward(source);
+                                  }
+                                  print_stats("forward", sender.stats()); });
+    std::thread receiver_thread([&, socket = std::move(server)]() mutable
+                                {
+                                    auto sink = Channel(sink_name);
+                                    auto receiver = bridge::Receiver<Frame>(std::move(socket));
+                                    while (receiver.republish(sink))
+                                    {
+                                    }
+                                    assert(receiver.stats().frames == N);
+                                    print_stats("republish", receiver.stats()); });
+
+    auto sink = Channel(sink_name);
+    for (int i = 0; i < N; ++i)
+    {
+        sink.consume([i](Frame const &frame)
+                     {
+                         assert(frame.frame_number == static_cast<std::uint64_t>(i) && "Frames must arrive in order");
+                         assert(frame.data.front() == static_cast<std::uint8_t>(i) && frame.data.back() == static_cast<std::uint8_t>(i));
+                         (void)frame;
+                         (void)i; });
+    }
+    camera.join();
+    sender_thread.join(); // closing the sender ends the receiver loop
+    receiver_thread.join();
+}
+
+void test_size_mismatch()
+{
+    fmt::print("Test bridge rejects a frame of the wrong size\n");
+    auto listener = bridge::listen_tcp(0);
+    auto client = bridge::connect_tcp("127.0.0.1", bridge::local_port(listener));
+    auto receiver = bridge::Receiver<Frame>(bridge::accept(listener));
+    bridge::Sender<std::uint64_t>(std::move(client), false).send(42);
+
+    auto frame = std::make_unique<Frame>();
+    bool thrown = false;
+    try
+    {
+        receiver.receive(*frame);
+    }
+    catch (std::runtime_error const &)
+    {
+        thrown = true;
+    }
+    assert(thrown && "Mismatched payload size should throw");
+    (void)thrown;
+}
+
+void test_truncated_frame()
+{
+    fmt::print("Test bridge throws when the stream ends inside a header or payload\n");
+    auto const header = bridge::FrameHeader{bridge::FrameHeader::MAGIC, 0, sizeof(Frame), 0, 0};
+    auto const payload = std::array<char, 1024>{};
+    auto truncated = [&](std::size_t header_bytes, std::size_t payload_bytes)
+    {
+        auto listener = bridge::listen_tcp(0);
+        auto client = bridge::connect_tcp("127.0.0.1", bridge::local_port(listener));
+        auto receiver = bridge::Receiver<Frame>(bridge::accept(listener));
+        ::send(client.get(), &header, header_bytes, MSG_NOSIGNAL);
+        ::send(client.get(), payload.data(), payload_bytes, MSG_NOSIGNAL);
+        client = bridge::Fd{}; // close
+
+        auto frame = std::make_unique<Frame>();
+        try
+        {
+            receiver.receive(*frame);
+        }
+        catch (std::runtime_error const &)
+        {
+            return true;
+        }
+        return false;
+    };
+    assert(truncated(sizeof(header) / 2, 0) && "End of stream inside a header should throw");
+    assert(truncated(sizeof(header), payload.size()) && "End of stream inside a payload should throw");
+    (void)truncated;
+}
+
+int main()
+{
+    test_tcp_loopback();
+    test_unix_stream();
+    test_shm_to_shm();
+    test_size_mismatch();
+    test_truncated_frame();
+    fmt::print("All tests passed!\n");
+    return 0;
+}
@@ -0,0 +1,89 @@
+#include "image-shm-dblbuf/tiled_image.hpp"
+#include <atomic>
+#include <cassert>
+#include <fmt/core.h>
+#include <memory>
+
+using Tiled = img::TiledImage<200, 130, img::ImageType::RGB, 64>;
+using Linear = img::LinearImageOf<Tiled>;
+
+std::uint8_t pattern(std::size_t x, std::size_t y, std::size_t c)
+{
+    return static_cast<std::uint8_t>(x * 7 + y * 13 + c);
+}
+
+void test_round_trip()
+{
+    fmt::print("Test tiled layout round trip with padded edge tiles\n");
+    static_assert(Tiled::tiles_x == 4 && Tiled::tiles_y == 3);
+
+    auto linear = std::make_unique<Linear>();
+    linear->timestamp = 11;
+    linear->frame_number = 22;
+    for (std::size_t y = 0; y < Linear::height; ++y)
+    {
+        for (std::size_t x = 0; x < Linear::width; ++x)
+        {
+            for (std::size_t c = 0; c < 3; ++c)
+            {
+                linear->data[(y * Linear::width + x) * 3 + c] = pattern(x, y, c);
+            }
+        }
+    }
+
+    auto pool = img::TilePool(3);
+    auto tiled = std::make_unique<Tiled>();
+    img::to_tiled(*linear, *tiled, &pool);
+    assert(tiled->frame_number == 22);
+    assert(reinterpret_cast<std::uintptr_t>(tiled->tile(1, 1).data()) % 64 == 0 && "Tiles must be cache-line aligned");
+
+    // pixel (70, 65) lives in tile (1, 1) at (6, 1)
+    auto const tile = tiled->tile(1, 1);
+    assert(tile[(1 * 64 + 6) * 3 + 2] == pattern(70, 65, 2));
+    // padding of the bottom-right tile is zeroed
+    auto const edge = tiled->tile(3, 2);
+    assert(edge[(2 * 64 + 0) * 3] == 0 && "Rows below the image are padding");
+    assert(edge[(0 * 64 + 10) * 3] == 0 && "Columns right of the image are padding");
+    (void)tile;
+    (void)edge;
+
+    auto back = std::make_unique<Linear>();
+    img::to_linear(*tiled, *back, &pool);
+    assert(back->timestamp == 11);
+    assert(back->data == linear->data && "Round trip must be lossless");
+
+    // Without a pool the calling thread converts every tile
+    auto single = std::make_unique<Tiled>();
+    img::to_tiled(*linear, *single);
+    assert(single->data == tiled->data);
+}
+
+void test_parallel_tiles()
+{
+    fmt::print("Test for_each_tile visits every tile once on a reused pool\n");
+    // More threads than tiles leaves some workers idle for the job
+    for (std::size_t threads : {std::size_t{5}, Tiled::tile_count + 4})
+    {
+        auto pool = img::TilePool(threads);
+        for (int round = 0; round < 100; ++round)
+        {
+            std::atomic<std::size_t> visits{0};
+            std::atomic<std::size_t> index_sum{0};
+            img::for_each_tile<Tiled>([&](std::size_t tx, std::size_t ty)
+                                      {
+                                          visits.fetch_add(1);
+                                          index_sum.fetch_add(ty * Tiled::tiles_x + tx); },
+                                      &pool);
+            assert(visits == Tiled::tile_count);
+            assert(index_sum == Tiled::tile_count * (Tiled::tile_count - 1) / 2);
+        }
+    }
+}
+
+int main()
+{
+    test_round_trip();
+    test_parallel_tiles();
+    fmt::print("All tests passed!\n");
+    return 0;
+}